@@ -43,26 +43,15 @@ function getOrSetUploadDate(dateToSetOrUndefined) {
     return ISOStringToDate(ctrl.value)
 }
 
-/** Get or set timezone
- * @param {number | undefined} timezoneOrUndefined * @returns {number | NaN} */
+/** Get or set timezone POSIX TZ rules
+ * @param {string | undefined} timezoneOrUndefined * @returns {string} */
  function getOrSetTimezone(timezoneOrUndefined) {
     const ctrl = document.getElementById('edittimezone')
-    if (typeof timezoneOrUndefined == 'number') {
+    if (typeof timezoneOrUndefined == 'string') {
         ctrl.value = timezoneOrUndefined
         return timezoneOrUndefined
     }
-    return parseInt(ctrl.value)
-}
-
-/** Get or set daylight
- * @param {number | undefined} daylightOrUndefined * @returns {number | NaN} */
- function getOrSetDaylight(daylightOrUndefined) {
-    const ctrl = document.getElementById('editdaylight')
-    if (typeof daylightOrUndefined == 'number') {
-        ctrl.value = daylightOrUndefined
-        return daylightOrUndefined
-    }
-    return parseInt(ctrl.value)
+    return ctrl.value
 }
 
 /** Get or set ntpenabled
@@ -76,6 +65,17 @@ function getOrSetUploadDate(dateToSetOrUndefined) {
     return ctrl.checked
 }
 
+/** Get or set time beacon role
+ * @param {number | undefined} roleOrUndefined * @returns {number} */
+function getOrSetBeaconRole(roleOrUndefined) {
+    const ctrl = document.getElementById('selectbeaconrole')
+    if (typeof roleOrUndefined == 'number') {
+        ctrl.value = roleOrUndefined
+        return roleOrUndefined
+    }
+    return parseInt(ctrl.value)
+}
+
 /** Get or set timeservers uri
  * @param {number} index * @param {string | undefined} timeserverUriOrUndefined * @returns {string} */
  function getOrSetTimeserver(index, timeserverUriOrUndefined) {
@@ -98,6 +98,63 @@ function getOrSetUploadDate(dateToSetOrUndefined) {
     return parseInt(ctrl.value)
 }
 
+/** Get or set display animation frame rate
+ * @param {number | undefined} fpsOrUndefined * @returns {number | NaN} */
+ function getOrSetDisplayFps(fpsOrUndefined) {
+    const ctrl = document.getElementById('editfps')
+    if (typeof fpsOrUndefined == 'number') {
+        ctrl.value = fpsOrUndefined
+        return fpsOrUndefined
+    }
+    return parseInt(ctrl.value)
+}
+
+/** Get or set automatic brightness mode, night brightness and light sensor range
+ * @param {{brightnessmode: number, nightbrightness: number, sensordark: number, sensorbright: number} | undefined} stateOrUndefined
+ * @returns {{brightnessmode: number, nightbrightness: number, sensordark: number, sensorbright: number}} */
+function getOrSetAutoBrightness(stateOrUndefined) {
+    const mode = document.getElementById('selectbrightnessmode')
+    const night = document.getElementById('editnightbrightness')
+    const range = document.getElementById('editsensorrange')
+    if (typeof stateOrUndefined == 'object') {
+        mode.value = stateOrUndefined.brightnessmode
+        night.value = stateOrUndefined.nightbrightness
+        if (typeof stateOrUndefined.sensordark == 'number') {
+            range.value = `${stateOrUndefined.sensordark}-${stateOrUndefined.sensorbright}`
+        }
+        return stateOrUndefined
+    }
+    const [dark, bright] = range.value.split('-').map(v => parseInt(v))
+    return {
+        brightnessmode: parseInt(mode.value),
+        nightbrightness: parseInt(night.value),
+        sensordark: dark,
+        sensorbright: bright
+    }
+}
+
+/** Get or set clock face
+ * @param {number | undefined} faceOrUndefined * @returns {number} */
+function getOrSetDisplayFace(faceOrUndefined) {
+    const ctrl = document.getElementById('selectface')
+    if (typeof faceOrUndefined == 'number') {
+        ctrl.value = faceOrUndefined
+        return faceOrUndefined
+    }
+    return parseInt(ctrl.value)
+}
+
+/** Get or set strip power budget
+ * @param {number | undefined} budgetOrUndefined * @returns {number | NaN} */
+function getOrSetPowerBudget(budgetOrUndefined) {
+    const ctrl = document.getElementById('editpowerbudget')
+    if (typeof budgetOrUndefined == 'number') {
+        ctrl.value = budgetOrUndefined
+        return budgetOrUndefined
+    }
+    return parseInt(ctrl.value)
+}
+
 /** Gets and sets display colors
  * @param {string | undefined} displayColorsOrUndefined * @returns {string} */
 function getOrSetDisplayColors(displayColorsOrUndefined) {
@@ -121,13 +178,17 @@ function updateColorPickers(colors) {
 function updateControls(state) {
     getOrSetUploadDate(getOrSetDeviceDate(ISOStringToDate(state.date)))
     getOrSetTimezone(state.timezone)
-    getOrSetDaylight(state.daylight)
     getOrSetNTPEnabled(state.ntpenabled)
+    getOrSetBeaconRole(state.beaconrole)
     getOrSetTimeserver(1, state.ntpserver1)
     getOrSetTimeserver(2, state.ntpserver2)
     getOrSetTimeserver(3, state.ntpserver3)
     getOrSetDisplayBrightness(state.brightness)
     getOrSetDisplayColors(state.colors)
+    getOrSetDisplayFps(state.fps)
+    getOrSetAutoBrightness(state)
+    getOrSetPowerBudget(state.powerbudget)
+    getOrSetDisplayFace(state.face)
     updateColorPickers(state.colors)
 }
 
@@ -138,7 +199,7 @@ function setStatus(text) {
 function requestState() {
     if (window.location.hostname == '') {
         setStatus("Device state accepted")
-        updateControls(JSON.parse('{"date":"20221108T102641Z", "timezone":3, "daylight":0, "ntpenabled":true, "ntpserver1":"0.pool.ntp.org", "ntpserver2":"1.pool.ntp.org", "ntpserver3":"time.nist.gov", "brightness":25, "colors":"0808220000443333AAFF0000001100"}'))
+        updateControls(JSON.parse('{"date":"20221108T102641Z", "timezone":"MSK-3", "ntpenabled":true, "ntpserver1":"0.pool.ntp.org", "ntpserver2":"1.pool.ntp.org", "ntpserver3":"time.nist.gov", "beaconrole":0, "brightness":25, "colors":"0808220000443333AAFF0000001100", "face":0, "fps":0, "fpsachieved":0, "dropped":0, "brightnessmode":0, "nightbrightness":10, "sensordark":20, "sensorbright":600, "powerbudget":2000, "current":120, "currentpeak":480}'))
         return
     }
 
@@ -193,9 +254,27 @@ function buttonSyncronizeTimeClick() {
     rq.send('')
 }
 
+function buttonSetDeviceSyncroClick() {
+    MakeRequestAsync('POST', 'set-ntp', {
+        timezone: getOrSetTimezone(),
+        ntpenabled: getOrSetNTPEnabled() ? 1 : 0,
+        beaconrole: getOrSetBeaconRole(),
+        ntpserver1: getOrSetTimeserver(1),
+        ntpserver2: getOrSetTimeserver(2),
+        ntpserver3: getOrSetTimeserver(3)
+    }).then(result => {
+        setStatus(result.status == 200 ? 'NTP settings commited' : result.response)
+        requestState()
+    }).catch(setStatus)
+}
+
 function buttonCommitDisplaySettingsClick() {
     const brightness = getOrSetDisplayBrightness()
     const colors = getOrSetDisplayColors()
+    const fps = getOrSetDisplayFps()
+    const auto = getOrSetAutoBrightness()
+    const powerbudget = getOrSetPowerBudget()
+    const face = getOrSetDisplayFace()
 
     let rq = new XMLHttpRequest()
     rq.open('POST', 'set-display', true)
@@ -205,7 +284,9 @@ function buttonCommitDisplaySettingsClick() {
             setStatus('Display settings commited')
         }
     }
-    rq.send(`brightness=${brightness}&colors=${colors}`)
+    rq.send(`brightness=${brightness}&colors=${colors}&fps=${fps}&face=${face}` +
+        `&brightnessmode=${auto.brightnessmode}&nightbrightness=${auto.nightbrightness}` +
+        `&sensordark=${auto.sensordark}&sensorbright=${auto.sensorbright}&powerbudget=${powerbudget}`)
 }
 
 /** @param {'GET'|'POST'} method @param {string} url @param {object} params
@@ -223,7 +304,7 @@ function MakeRequestAsync(method, url, params = undefined) {
         if (params) {
             rq.setRequestHeader('Content-Type', 'application/x-www-form-urlencoded')
             rq.send(Object.keys(params).reduce(
-                (a, k) => `${a}${a.length ? '&' : ''}${k}=${params[k]}`, ''))
+                (a, k) => `${a}${a.length ? '&' : ''}${k}=${encodeURIComponent(params[k])}`, ''))
         } else rq.send()
     })
 }
@@ -239,8 +320,45 @@ function displayColorChaged(index, color) {
        color.substring(1) + colors.substring(6 + index * 6));
 }
 
+/** Subscribes to device event stream pushing time, sync and display changes
+ * @returns {boolean} false when event stream is not available */
+function subscribeEvents() {
+    if (typeof EventSource == 'undefined' || window.location.hostname == '') {
+        return false
+    }
+
+    const source = new EventSource('events')
+    source.addEventListener('status', function(e) {
+        updateControls(JSON.parse(e.data))
+        setStatus("Device state accepted")
+    })
+    source.addEventListener('time', function(e) {
+        getOrSetDeviceDate(ISOStringToDate(e.data))
+    })
+    source.addEventListener('sync', function(e) {
+        const sync = JSON.parse(e.data)
+        setStatus(sync.beaconlocked ? `Following time beacon, phase error ${sync.beaconphase / 1000} ms` :
+            sync.ntpsynced ? `NTP synchronized, offset ${sync.ntpoffset / 1000} ms, delay ${sync.ntpdelay / 1000} ms` : 'NTP not synchronized')
+    })
+    source.addEventListener('display', function(e) {
+        const state = JSON.parse(e.data)
+        getOrSetDisplayBrightness(state.brightness)
+        getOrSetDisplayColors(state.colors)
+        getOrSetDisplayFps(state.fps)
+        getOrSetAutoBrightness(state)
+        getOrSetDisplayFace(state.face)
+        updateColorPickers(state.colors)
+    })
+    source.onerror = function() {
+        setStatus("Event stream disconnected, reconnecting")
+    }
+    return true
+}
+
 document.addEventListener("DOMContentLoaded", function() {
-    requestState()
+    if (!subscribeEvents()) {
+        requestState()
+    }
 })
 
 setInterval(updateCurrentTime, 1000) // update device time clock
@@ -0,0 +1,99 @@
+# PlatformIO pre-build script: minifies and gzips web UI from data/ into
+# .pio/webui which becomes the LittleFS image source. Styles and scripts get
+# content hash in file name (served with long max-age), every file gets ETag
+# listed in /etags manifest loaded by firmware.
+
+import gzip
+import hashlib
+import os
+import re
+import shutil
+
+Import("env")
+
+HASHED_EXTENSIONS = (".css", ".js")
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    return re.sub(r"\s*([{};,])\s*", r"\1", text).strip()
+
+
+def minify_js(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    lines = (line.strip() for line in text.splitlines())
+    return "\n".join(line for line in lines if line and not line.startswith("//"))
+
+
+def minify_html(text):
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    lines = (line.strip() for line in text.splitlines())
+    return "\n".join(line for line in lines if line)
+
+
+MINIFIERS = {".css": minify_css, ".js": minify_js, ".html": minify_html, ".htm": minify_html}
+
+
+def content_hash(data):
+    return hashlib.sha1(data).hexdigest()[:10]
+
+
+def write_gzip(path, data):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "wb") as raw:
+        with gzip.GzipFile(filename="", mode="wb", fileobj=raw, compresslevel=9, mtime=0) as gz:
+            gz.write(data)
+
+
+def build(source_dir, output_dir):
+    assets = {}     # relative source path -> minified content
+    renames = {}    # relative source path -> relative served path
+    for root, _, files in os.walk(source_dir):
+        for name in files:
+            path = os.path.join(root, name)
+            rel = os.path.relpath(path, source_dir).replace(os.sep, "/")
+            ext = os.path.splitext(name)[1].lower()
+            with open(path, "rb") as f:
+                data = f.read()
+            if ext in MINIFIERS:
+                data = MINIFIERS[ext](data.decode("utf-8")).encode("utf-8")
+            assets[rel] = data
+            if ext in HASHED_EXTENSIONS:
+                base, _ = os.path.splitext(rel)
+                renames[rel] = "%s.%s%s" % (base, content_hash(data), ext)
+            else:
+                renames[rel] = rel
+
+    # point documents to hashed asset names
+    for rel, data in assets.items():
+        if rel.endswith((".html", ".htm")):
+            text = data.decode("utf-8")
+            for original, renamed in renames.items():
+                if original != renamed:
+                    text = text.replace(original, renamed)
+            assets[rel] = text.encode("utf-8")
+
+    if os.path.isdir(output_dir):
+        shutil.rmtree(output_dir)
+    os.makedirs(output_dir)
+
+    manifest = []
+    original_size = compressed_size = 0
+    for rel, data in sorted(assets.items()):
+        served = renames[rel] + ".gz"
+        write_gzip(os.path.join(output_dir, served), data)
+        manifest.append("/%s \"%s\"" % (served, content_hash(data)))
+        original_size += os.path.getsize(os.path.join(source_dir, rel))
+        compressed_size += os.path.getsize(os.path.join(output_dir, served))
+
+    with open(os.path.join(output_dir, "etags"), "w") as f:
+        f.write("\n".join(manifest) + "\n")
+
+    print("Web UI: %d files, %d -> %d bytes" % (len(assets), original_size, compressed_size))
+
+
+source_dir = env.subst("$PROJECT_DATA_DIR")
+output_dir = os.path.join(env.subst("$PROJECT_DIR"), ".pio", "webui")
+build(source_dir, output_dir)
+env.Replace(PROJECT_DATA_DIR=output_dir)
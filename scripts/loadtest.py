@@ -0,0 +1,187 @@
+# HTTP load harness for the clock, standard library only, runs on any host with
+# Python 3 on the same network as the device:
+#
+#   python3 scripts/loadtest.py 192.168.1.50 --connections 8 --duration 60 --events 2
+#
+# Worker threads request --path (default /status) back to back while --events
+# clients hold /events streams open. Client side latency percentiles are taken
+# from every request. loop() pushes a "time" event right after rendering each
+# second, so deviation of their arrival interval from one second shows render
+# jitter under load. Device side render, show and loop time percentiles and
+# dropped frames come from /metrics scraped before and after the run, so only
+# time spent under load is reported. Compare sync and async builds (nodemcuv2 and nodemcuv2_async) by
+# flashing each and running same command.
+
+import argparse
+import re
+import socket
+import threading
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+METRIC = re.compile(r'^(\w+?)(?:\{(.*)\})? (\S+)$')
+DEVICE_HISTOGRAMS = ("clock_render_seconds", "clock_show_seconds", "clock_loop_seconds")
+DEVICE_COUNTERS = ("clock_frames_dropped_total",)
+
+
+def scrape(base, timeout):
+    with urllib.request.urlopen(base + "/metrics", timeout=timeout) as response:
+        text = response.read().decode()
+    samples = {}
+    for line in text.splitlines():
+        match = METRIC.match(line)
+        if match:
+            name, labels, value = match.groups()
+            samples[(name, labels or "")] = float(value)
+    return samples
+
+
+def buckets(samples, name):
+    result = []
+    for (metric, labels), value in samples.items():
+        match = re.search(r'le="([^"]+)"', labels)
+        if metric == name + "_bucket" and match and "route=" not in labels:
+            result.append((float(match.group(1)), value))
+    return sorted(result)
+
+
+# upper bucket bound holding quantile of observations recorded between scrapes
+def histogram_quantile(before, after, name, quantile):
+    start = dict(buckets(before, name))
+    cumulative = [(bound, count - start.get(bound, 0)) for bound, count in buckets(after, name)]
+    if not cumulative or cumulative[-1][1] == 0:
+        return None
+    target = quantile * cumulative[-1][1]
+    for bound, count in cumulative:
+        if count >= target:
+            return bound
+    return float("inf")
+
+
+def percentile(values, quantile):
+    if not values:
+        return None
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(quantile * len(ordered)))]
+
+
+def milliseconds(seconds):
+    if seconds is None:
+        return "-"
+    if seconds == float("inf"):
+        return "overflow"
+    return "%.2f ms" % (seconds * 1000)
+
+
+class Load:
+    def __init__(self, base, path, timeout):
+        self.base = base
+        self.path = path
+        self.timeout = timeout
+        self.latencies = []
+        self.errors = {}
+        self.jitter = []
+        self.lock = threading.Lock()
+
+    def worker(self, deadline):
+        while time.monotonic() < deadline:
+            start = time.monotonic()
+            try:
+                with urllib.request.urlopen(self.base + self.path, timeout=self.timeout) as response:
+                    response.read()
+                    error = None if response.status == 200 else str(response.status)
+            except urllib.error.HTTPError as e:
+                error = str(e.code)
+            except (urllib.error.URLError, socket.timeout, ConnectionError) as e:
+                error = type(getattr(e, "reason", e)).__name__
+            elapsed = time.monotonic() - start
+            with self.lock:
+                if error:
+                    self.errors[error] = self.errors.get(error, 0) + 1
+                else:
+                    self.latencies.append(elapsed)
+
+    # holds event stream open until deadline, counts received events and records
+    # how far apart from one second consecutive "time" events arrive
+    def subscriber(self, deadline, counts, index):
+        try:
+            url = urllib.parse.urlsplit(self.base)
+            sock = socket.create_connection((url.hostname, url.port or 80), timeout=self.timeout)
+            sock.sendall(b"GET /events HTTP/1.1\r\nHost: clock\r\nAccept: text/event-stream\r\n\r\n")
+            pending = b""
+            last = None
+            while time.monotonic() < deadline:
+                sock.settimeout(max(0.1, deadline - time.monotonic()))
+                try:
+                    data = sock.recv(2048)
+                except socket.timeout:
+                    break
+                if not data:
+                    break
+                arrived = time.monotonic()
+                pending += data
+                while b"\n\n" in pending:
+                    event, pending = pending.split(b"\n\n", 1)
+                    lines = event.split(b"\n")
+                    if not any(line.startswith(b"event:") for line in lines):
+                        continue
+                    counts[index] += 1
+                    if b"event: time" in lines:
+                        if last is not None:
+                            with self.lock:
+                                self.jitter.append(abs(arrived - last - 1.0))
+                        last = arrived
+            sock.close()
+        except OSError:
+            counts[index] = -1
+
+
+def main():
+    parser = argparse.ArgumentParser(description="HTTP load harness for clock firmware")
+    parser.add_argument("host", help="device address")
+    parser.add_argument("--path", default="/status", help="route requested by workers")
+    parser.add_argument("--connections", type=int, default=4, help="concurrent request workers")
+    parser.add_argument("--events", type=int, default=0, help="concurrent /events subscribers")
+    parser.add_argument("--duration", type=float, default=30, help="seconds of load")
+    parser.add_argument("--timeout", type=float, default=5, help="request timeout in seconds")
+    args = parser.parse_args()
+
+    base = "http://" + args.host
+    load = Load(base, args.path, args.timeout)
+    before = scrape(base, args.timeout)
+
+    deadline = time.monotonic() + args.duration
+    counts = [0] * args.events
+    threads = [threading.Thread(target=load.worker, args=(deadline,)) for _ in range(args.connections)]
+    threads += [threading.Thread(target=load.subscriber, args=(deadline, counts, i)) for i in range(args.events)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    after = scrape(base, args.timeout)
+
+    total = len(load.latencies) + sum(load.errors.values())
+    print("%s %s, %d connections, %d event streams, %.0f s" % (
+        args.host, args.path, args.connections, args.events, args.duration))
+    print("requests %d, %.1f/s, errors %s" % (
+        total, total / args.duration, load.errors or "none"))
+    print("client latency p50 %s p99 %s max %s" % (
+        milliseconds(percentile(load.latencies, 0.5)), milliseconds(percentile(load.latencies, 0.99)),
+        milliseconds(max(load.latencies) if load.latencies else None)))
+    if args.events:
+        print("events received per stream %s" % counts)
+        print("%-22s p50 %s p99 %s" % ("time event jitter",
+            milliseconds(percentile(load.jitter, 0.5)), milliseconds(percentile(load.jitter, 0.99))))
+    for name in DEVICE_HISTOGRAMS:
+        print("%-22s p50 <= %s p99 <= %s" % (name,
+            milliseconds(histogram_quantile(before, after, name, 0.5)),
+            milliseconds(histogram_quantile(before, after, name, 0.99))))
+    for name in DEVICE_COUNTERS:
+        print("%-22s +%d" % (name, after.get((name, ""), 0) - before.get((name, ""), 0)))
+    print("%-22s %d bytes" % ("heap free min", after.get(("clock_heap_free_min_bytes", ""), 0)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <lwip/udp.h>
+#include <lwip/pbuf.h>
+#include <sys/time.h>
+#include "control.h"
+#include "mytime.h"
+
+#define BEACON_OFF      0
+#define BEACON_LEADER   1   // broadcasts its time, synchronized by NTP
+#define BEACON_FOLLOWER 2   // disciplines its clock to leader beacons instead of NTP
+
+#define BEACON_PORT 7374
+#define BEACON_MAGIC 0x4254             // "TB"
+#define BEACON_VERSION 2
+#define BEACON_HEADER_SIZE 20           // magic, version, flags, boot, sequence, seconds, microseconds
+#define BEACON_PACKET_SIZE (BEACON_HEADER_SIZE + CONTROL_MAC_SIZE)
+#define BEACON_INTERVAL_MS 1000
+#define BEACON_TIMEOUT_MS 10000         // leader lost, next beacon locks again
+#define BEACON_WINDOW 8                 // samples searched for smallest network delay
+#define BEACON_STEP_US 50000            // larger phase errors step the clock
+#define BEACON_STEP_COUNT 5             // consecutive large errors agreeing within BEACON_STEP_SPREAD_US
+#define BEACON_STEP_SPREAD_US 10000
+#define BEACON_PHASE_SHIFT 3            // phase error share corrected per beacon, 1/8
+#define BEACON_DRIFT_GAIN 256           // phase error share added to drift per second
+#define BEACON_DRIFT_MAX_PPB 500000
+#define BEACON_ACCEPT_US 60000000LL     // beacon farther from valid local clock is not accepted
+
+// Phase and frequency filter of follower. Beacon delay is never negative, so the
+// largest offset (leader - local) of last BEACON_WINDOW samples has the smallest
+// delay. Its eighth corrects phase, integrated error tracks oscillator drift.
+// Beacons delayed far beyond the step threshold (buffered by AP for sleeping
+// stations) are ignored unless several consecutive ones agree on new offset.
+class BeaconFilter {
+    private:
+    int32_t _samples[BEACON_WINDOW];
+    uint8_t _count;
+    uint8_t _next;
+    uint8_t _outliers;
+    int32_t _outlierMin;
+    int32_t _outlierMax;
+    bool _locked;
+    int32_t _phase;     // last phase error, us
+    int32_t _drift;     // local oscillator vs leader, ppb, positive when local runs slow
+
+    public:
+    BeaconFilter() {
+        reset();
+    }
+
+    void reset() {
+        _count = _next = _outliers = 0;
+        _locked = false;
+        _phase = 0;
+        _drift = 0;
+    }
+
+    // correction to add to local clock, us, for offset (leader - local, us) of
+    // beacon received intervalMs after previous one
+    int64_t update(int64_t offset, uint32_t intervalMs) {
+        if (!_locked) {
+            _count = _next = _outliers = 0;
+            _locked = true;
+            _phase = offset;
+            return offset;
+        }
+        if (offset > BEACON_STEP_US || offset < -BEACON_STEP_US) {
+            const int32_t value = constrain(offset, INT32_MIN, INT32_MAX);
+            _outlierMin = _outliers && _outlierMin < value ? _outlierMin : value;
+            _outlierMax = _outliers && _outlierMax > value ? _outlierMax : value;
+            if (_outlierMax - _outlierMin > BEACON_STEP_SPREAD_US) {
+                _outliers = 0;  // late beacons, delayed by AP or busy loop()
+            }
+            else if (++_outliers == BEACON_STEP_COUNT) {
+                _count = _next = _outliers = 0;
+                _phase = _outlierMax;
+                return _outlierMax;
+            }
+            return 0;
+        }
+        _outliers = 0;
+
+        _samples[_next] = offset;
+        _next = (_next + 1) % BEACON_WINDOW;
+        if (_count < BEACON_WINDOW) {
+            _count++;
+        }
+        int32_t best = _samples[0];
+        for (uint8_t i = 1; i < _count; i++) {
+            best = _samples[i] > best ? _samples[i] : best;
+        }
+        _phase = best;
+
+        if (intervalMs) {
+            _drift += (int64_t)best * 1000000 / ((int64_t)BEACON_DRIFT_GAIN * intervalMs);
+            _drift = constrain(_drift, -BEACON_DRIFT_MAX_PPB, BEACON_DRIFT_MAX_PPB);
+        }
+        const int32_t correction = (best >> BEACON_PHASE_SHIFT) + (int64_t)_drift * intervalMs / 1000000;
+        for (uint8_t i = 0; i < _count; i++) {
+            _samples[i] -= correction;
+        }
+        return correction;
+    }
+
+    bool isLocked() const {
+        return _locked;
+    }
+
+    int32_t getPhase() const {
+        return _phase;
+    }
+
+    int32_t getDrift() const {
+        return _drift;
+    }
+};
+
+// Time beacons for clocks mounted side by side. Leader broadcasts its time once
+// per second, followers slew their system clock to it so seconds of all displays
+// flip together. Receive time is taken in lwIP callback, loop() sleeping in idle
+// scheduler does not delay it. Beacons are authenticated with control key.
+// Leader draws random boot ID on start and numbers beacons from one. Follower
+// remembers boot, sequence and leader time of last accepted beacon, also while
+// unlocked, so replayed beacon is older than that and rejected; beacon of new boot
+// (restarted leader) is accepted when its time did not go back. Once local clock
+// is valid, beacons farther than BEACON_ACCEPT_US from it are not accepted either.
+class TimeBeacon {
+    private:
+    udp_pcb* _pcb;
+    uint8_t _role;
+    br_hmac_key_context _key;
+    uint32_t _boot;             // leader: own boot ID, follower: of last accepted beacon
+    uint32_t _sequence;         // leader: last sent, follower: last accepted
+    int64_t _leaderTime;        // follower: leader time of last accepted beacon, us
+    uint32_t _nextSend;
+    uint32_t _lastAccepted;     // millis() of last accepted beacon
+    int64_t _lastReceived;      // local time of its reception, us
+    IPAddress _leader;
+    BeaconFilter _filter;
+
+    // written by receive callback, latest beacon wins
+    bool _pending;
+    int64_t _received;          // local time of reception, us
+    IPAddress _from;
+    uint8_t _packet[BEACON_PACKET_SIZE];
+
+    static int64_t nowMicros() {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+
+    static uint32_t read32(const uint8_t* p) {
+        return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    static void write32(uint8_t* p, uint32_t value) {
+        p[0] = value;
+        p[1] = value >> 8;
+        p[2] = value >> 16;
+        p[3] = value >> 24;
+    }
+
+    static void received(void* arg, udp_pcb*, pbuf* p, const ip_addr_t* addr, u16_t) {
+        TimeBeacon* self = (TimeBeacon*)arg;
+        const int64_t now = nowMicros();
+        if (self->_role == BEACON_FOLLOWER && p->tot_len == BEACON_PACKET_SIZE) {
+            pbuf_copy_partial(p, self->_packet, BEACON_PACKET_SIZE, 0);
+            self->_received = now;
+            self->_from = IPAddress(addr);
+            self->_pending = true;
+        }
+        pbuf_free(p);
+    }
+
+    void send() {
+        uint8_t packet[BEACON_PACKET_SIZE];
+        packet[0] = BEACON_MAGIC & 0xFF;
+        packet[1] = BEACON_MAGIC >> 8;
+        packet[2] = BEACON_VERSION;
+        packet[3] = 0;
+        write32(packet + 4, _boot);
+        write32(packet + 8, ++_sequence);
+        const int64_t now = nowMicros();
+        write32(packet + 12, now / 1000000);
+        write32(packet + 16, now % 1000000);
+        ControlServer::mac(_key, packet, BEACON_HEADER_SIZE, packet + BEACON_HEADER_SIZE);
+
+        pbuf* p = pbuf_alloc(PBUF_TRANSPORT, BEACON_PACKET_SIZE, PBUF_RAM);
+        if (!p) {
+            return;
+        }
+        pbuf_take(p, packet, BEACON_PACKET_SIZE);
+        const IPAddress broadcast = WiFi.broadcastIP();
+        udp_sendto(_pcb, p, broadcast, BEACON_PORT);
+        pbuf_free(p);
+    }
+
+    void follow() {
+        _pending = false;
+        uint8_t mac[CONTROL_MAC_SIZE];
+        ControlServer::mac(_key, _packet, BEACON_HEADER_SIZE, mac);
+        if ((_packet[0] | _packet[1] << 8) != BEACON_MAGIC || _packet[2] != BEACON_VERSION ||
+                memcmp(mac, _packet + BEACON_HEADER_SIZE, CONTROL_MAC_SIZE) != 0 ||
+                (_filter.isLocked() && _from != _leader)) {
+            return;
+        }
+        const uint32_t boot = read32(_packet + 4), sequence = read32(_packet + 8);
+        const int64_t leader = (int64_t)read32(_packet + 12) * 1000000 + read32(_packet + 16);
+        if (boot == _boot ? sequence <= _sequence : leader <= _leaderTime) {
+            return; // replayed or reordered
+        }
+        const int64_t skew = leader - _received;
+        if (_received >= TIME_VALID_SINCE * 1000000 && (skew > BEACON_ACCEPT_US || skew < -BEACON_ACCEPT_US)) {
+            return;
+        }
+        if (_boot && boot != _boot) {
+            Serial.println("Time beacon leader restarted");
+        }
+
+        const bool locked = _filter.isLocked();
+        const uint32_t interval = locked ? (_received - _lastReceived) / 1000 : 0;
+        const int64_t correction = _filter.update(leader - _received, interval);
+        if (correction) {
+            const int64_t us = nowMicros() + correction;
+            timeval tv = { (time_t)(us / 1000000), (suseconds_t)(us % 1000000) };
+            settimeofday(&tv, NULL);
+        }
+        if (!locked) {
+            Serial.print("Time beacon leader: ");
+            Serial.println(_from);
+        }
+        _boot = boot;
+        _sequence = sequence;
+        _leaderTime = leader;
+        _leader = _from;
+        _lastAccepted = millis();
+        _lastReceived = _received + correction;
+    }
+
+    public:
+    TimeBeacon() : _pcb(nullptr), _role(BEACON_OFF), _key(), _boot(0), _sequence(0), _leaderTime(0),
+        _nextSend(0), _lastAccepted(0), _lastReceived(0), _pending(false), _received(0) {
+    }
+
+    ~TimeBeacon() {
+        if (_pcb) {
+            udp_remove(_pcb);
+        }
+    }
+
+    // start in role, beacons are authenticated with control key
+    bool begin(uint8_t role, const char* secret) {
+        _role = BEACON_OFF;
+        _filter.reset();
+        if (role == BEACON_OFF || role > BEACON_FOLLOWER) {
+            return role == BEACON_OFF;
+        }
+        if (!ControlServer::initKey(_key, secret)) {
+            return false;
+        }
+        if (!_pcb) {
+            _pcb = udp_new();
+            if (!_pcb || udp_bind(_pcb, IP_ANY_TYPE, BEACON_PORT) != ERR_OK) {
+                return false;
+            }
+            ip_set_option(_pcb, SOF_BROADCAST);
+            udp_recv(_pcb, received, this);
+        }
+        if (role == BEACON_LEADER) {
+            _boot = ESP.random() | 1;   // nonzero, zero means none seen by follower
+            _sequence = 0;
+        }
+        _role = role;
+        _nextSend = millis();
+        return true;
+    }
+
+    // poll from loop(), leader needs valid time to send beacons
+    void poll(bool connected) {
+        if (_role == BEACON_LEADER) {
+            if (connected && (int32_t)(millis() - _nextSend) >= 0) {
+                _nextSend = millis() + BEACON_INTERVAL_MS;
+                if (time(NULL) >= TIME_VALID_SINCE) {
+                    send();
+                }
+            }
+        }
+        else if (_role == BEACON_FOLLOWER) {
+            if (_pending) {
+                follow();
+            }
+            if (_filter.isLocked() && millis() - _lastAccepted > BEACON_TIMEOUT_MS) {
+                Serial.println("Time beacon leader lost");
+                _filter.reset();
+            }
+        }
+    }
+
+    // millis() when poll() has work next, follower samples are timestamped on arrival
+    // and may wait for next wakeup
+    uint32_t nextDeadline() const {
+        const uint32_t now = millis();
+        if (_role == BEACON_LEADER) {
+            return _nextSend;
+        }
+        if (_role == BEACON_FOLLOWER && _filter.isLocked()) {
+            return _pending ? now : _lastAccepted + BEACON_TIMEOUT_MS;
+        }
+        return now + BEACON_TIMEOUT_MS;
+    }
+
+    uint8_t getRole() const {
+        return _role;
+    }
+
+    bool isLocked() const {
+        return _filter.isLocked();
+    }
+
+    // phase error to leader after smallest delay filtering, us
+    int32_t getPhase() const {
+        return _filter.getPhase();
+    }
+
+    // frequency error of local oscillator, ppb
+    int32_t getDrift() const {
+        return _filter.getDrift();
+    }
+};
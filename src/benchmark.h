@@ -0,0 +1,133 @@
+#pragma once
+
+#include <Arduino.h>
+#include <inttypes.h>
+#ifndef ESP8266
+#include <chrono>
+#include <new>
+#endif
+
+#define BENCHMARK_ITERATIONS 200
+
+// Micro benchmark, times callback and prints time per call over Serial together
+// with heap allocations per call. On device time is taken from CPU cycle counter,
+// on host from steady clock.
+//
+// Allocations are counted when malloc family is wrapped by linker, see benchmark
+// environments in platformio.ini: -D BENCHMARK_WRAP_MALLOC and
+// -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc. Allocations of SDK
+// internals calling umm_malloc directly are not seen.
+class Benchmark {
+    public:
+    static uint32_t& allocations() {
+        static uint32_t count = 0;
+        return count;
+    }
+
+    static uint32_t& frees() {
+        static uint32_t count = 0;
+        return count;
+    }
+
+    static volatile uint32_t& sink() {
+        static volatile uint32_t value = 0;
+        return value;
+    }
+
+    // consume result so that optimizer keeps call being measured
+    static void keep(uint32_t value) {
+        sink() = value;
+    }
+
+    // returns nanoseconds per call
+    template <typename Callback>
+    static uint32_t run(const char* name, Callback callback, uint16_t iterations = BENCHMARK_ITERATIONS) {
+        ESP.wdtFeed();
+        callback(0); // warm up caches and lazy initializations
+
+        const uint32_t heap = ESP.getFreeHeap();
+        const uint32_t allocs = allocations(), freed = frees();
+#ifdef ESP8266
+        const uint32_t start = ESP.getCycleCount();
+        for (uint16_t i = 0; i < iterations; i++) {
+            callback(i);
+        }
+        const uint32_t cycles = (ESP.getCycleCount() - start) / iterations;
+        const uint32_t nanos = cycles * 1000 / (F_CPU / 1000000);
+#else
+        const auto start = std::chrono::steady_clock::now();
+        for (uint16_t i = 0; i < iterations; i++) {
+            callback(i);
+        }
+        const uint32_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count() / iterations;
+#endif
+        // hundredths per call, allocations are rare enough to need fraction
+        const uint32_t allocsPerOp = (allocations() - allocs) * 100 / iterations;
+        const uint32_t freesPerOp = (frees() - freed) * 100 / iterations;
+
+#ifdef ESP8266
+        Serial.printf("%-20s %8" PRIu32 " cycles/op %8" PRIu32 " ns/op", name, cycles, nanos);
+#else
+        Serial.printf("%-20s %8" PRIu32 " ns/op", name, nanos);
+#endif
+#ifdef BENCHMARK_WRAP_MALLOC
+        Serial.printf("  allocs %" PRIu32 ".%02" PRIu32 "/op  frees %" PRIu32 ".%02" PRIu32 "/op",
+            allocsPerOp / 100, allocsPerOp % 100, freesPerOp / 100, freesPerOp % 100);
+#endif
+        Serial.printf("  heap %+d bytes\n", (int)ESP.getFreeHeap() - (int)heap);
+        return nanos;
+    }
+};
+
+#ifdef BENCHMARK_WRAP_MALLOC
+// weak so that header may be included from more than one translation unit
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+__attribute__((weak)) void* __wrap_malloc(size_t size) {
+    Benchmark::allocations()++;
+    return __real_malloc(size);
+}
+
+__attribute__((weak)) void* __wrap_calloc(size_t count, size_t size) {
+    Benchmark::allocations()++;
+    return __real_calloc(count, size);
+}
+
+__attribute__((weak)) void* __wrap_realloc(void* ptr, size_t size) {
+    Benchmark::allocations()++;
+    return __real_realloc(ptr, size);
+}
+
+__attribute__((weak)) void __wrap_free(void* ptr) {
+    if (ptr) {
+        Benchmark::frees()++;
+    }
+    __real_free(ptr);
+}
+}
+
+#ifndef ESP8266
+// host libstdc++ is a shared library and its operator new calls malloc past the
+// wrapper, replacement routes C++ allocations through it like core of device does
+__attribute__((weak)) void* operator new(size_t size) {
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+__attribute__((weak)) void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+__attribute__((weak)) void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+#endif
+#endif
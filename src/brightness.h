@@ -0,0 +1,146 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define BRIGHTNESS_MANUAL   0   // configured brightness all the time
+#define BRIGHTNESS_SENSOR   1   // ambient light on A0 maps between night and day brightness
+#define BRIGHTNESS_SCHEDULE 2   // day brightness from 6 to 18 hours, night brightness otherwise
+#define BRIGHTNESS_POLL_MS  200 // frequent analogRead() disturbs WiFi
+#define BRIGHTNESS_FILTER_SHIFT 3   // filter weight 1/8 per poll, time constant ~1.6 s
+
+#ifndef GAMMA_RED
+#define GAMMA_RED   2.2
+#endif
+#ifndef GAMMA_GREEN
+#define GAMMA_GREEN 2.2
+#endif
+#ifndef GAMMA_BLUE
+#define GAMMA_BLUE  2.2
+#endif
+
+// Per-channel gamma curves computed at compile time, perceived brightness level
+// is mapped to 16 bit linear scale so low levels keep their resolution
+struct GammaTable {
+    uint16_t scale[3][256];
+
+    static constexpr double LN2 = 0.6931471805599453;
+
+    static constexpr double ln(double x) {
+        int k = 0;
+        while (x < 1) {
+            x *= 2;
+            k--;
+        }
+        double z = (x - 1) / (x + 1), term = z, sum = 0;
+        for (int n = 1; n < 40; n += 2) {
+            sum += term / n;
+            term *= z * z;
+        }
+        return 2 * sum + k * LN2;
+    }
+
+    static constexpr double exp(double y) {
+        int k = 0;
+        while (y < -LN2) {
+            y += LN2;
+            k++;
+        }
+        double term = 1, sum = 1;
+        for (int n = 1; n < 25; n++) {
+            term *= y / n;
+            sum += term;
+        }
+        while (k--) {
+            sum /= 2;
+        }
+        return sum;
+    }
+
+    constexpr GammaTable() : scale() {
+        const double gamma[3] = { GAMMA_RED, GAMMA_GREEN, GAMMA_BLUE };
+        for (uint8_t c = 0; c < 3; c++) {
+            for (uint16_t i = 1; i < 256; i++) {
+                const uint16_t value = exp(gamma[c] * ln(i / 255.0)) * 65535 + 0.5;
+                scale[c][i] = value ? value : 1; // lowest levels still light set channels
+            }
+        }
+    }
+};
+
+static constexpr GammaTable GAMMA_TABLE PROGMEM;
+
+// Brightness level source: manual value, ambient light sensor or day/night schedule,
+// automatic target is smoothed so level changes fade instead of jumping
+class AutoBrightness {
+    private:
+    uint8_t _mode;
+    uint8_t _night;         // level for night hours or dark room
+    uint16_t _dark;         // ADC reading of dark room
+    uint16_t _bright;       // ADC reading of lit room
+    uint16_t _ambient;      // last ADC reading
+    uint16_t _filtered;     // smoothed level, 8.8 fixed point
+
+    public:
+    AutoBrightness() : _mode(BRIGHTNESS_MANUAL), _night(0), _dark(0), _bright(1023), _ambient(0), _filtered(0) {
+    }
+
+    static bool isValid(long mode, long night, long dark, long bright) {
+        return mode >= 0 && mode <= BRIGHTNESS_SCHEDULE && night >= 0 && night <= 0xFF &&
+            dark >= 0 && dark < bright && bright <= 1023;
+    }
+
+    bool configure(uint8_t mode, uint8_t night, uint16_t dark, uint16_t bright) {
+        if (!isValid(mode, night, dark, bright)) {
+            return false;
+        }
+        _mode = mode;
+        _night = night;
+        _dark = dark;
+        _bright = bright;
+        return true;
+    }
+
+    uint8_t getMode() { return _mode; }
+    uint8_t getNight() { return _night; }
+    uint16_t getDark() { return _dark; }
+    uint16_t getBright() { return _bright; }
+    uint16_t getAmbient() { return _ambient; }
+
+    // level for day brightness and current hour, call every BRIGHTNESS_POLL_MS
+    uint8_t update(uint8_t day, uint8_t hh) {
+        uint8_t target = day;
+        if (_mode == BRIGHTNESS_SENSOR) {
+            _ambient = analogRead(A0);
+            const uint16_t a = constrain(_ambient, _dark, _bright);
+            target = _night + ((int32_t)day - _night) * (a - _dark) / (_bright - _dark);
+        }
+        else if (_mode == BRIGHTNESS_SCHEDULE) {
+            target = (hh < 6 || hh > 17) ? _night : day;
+        }
+        else {
+            _filtered = day << 8;
+            return day;
+        }
+
+        _filtered += ((int32_t)(target << 8) - _filtered) >> BRIGHTNESS_FILTER_SHIFT;
+        return (_filtered + 0x80) >> 8;
+    }
+
+    // linear 16 bit scale of channel (0 red, 1 green, 2 blue) for level
+    static uint16_t scale(uint8_t channel, uint8_t level) {
+        return pgm_read_word(&GAMMA_TABLE.scale[channel][level]);
+    }
+
+    // level closest in green channel duty to linear brightness of earlier firmware
+    static uint8_t fromLinear(uint8_t duty) {
+        const uint16_t target = duty * 257;
+        uint8_t level = 0;
+        while (level < 255 && scale(1, level) < target) {
+            level++;
+        }
+        if (level && target - scale(1, level - 1) < scale(1, level) - target) {
+            level--;
+        }
+        return level;
+    }
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define CHECKSUM_CRC16_POLY 0xA001          // CRC-16/MODBUS, reflected
+#define CHECKSUM_CRC32_POLY 0xEDB88320UL    // CRC-32 (zlib, Ethernet), reflected
+#define CHECKSUM_SLICE_MIN 32               // shorter blobs gain nothing from slice-by-4
+
+// Lookup tables for reflected CRC computed at compile time, slice k holds CRC of
+// byte followed by k zero bytes for processing several bytes per step
+template <typename T, T POLY, uint8_t SLICES>
+struct CrcTable {
+    T entries[SLICES][256];
+
+    constexpr CrcTable() : entries() {
+        for (uint16_t i = 0; i < 256; i++) {
+            T crc = i;
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+            }
+            entries[0][i] = crc;
+        }
+        for (uint8_t k = 1; k < SLICES; k++) {
+            for (uint16_t i = 0; i < 256; i++) {
+                entries[k][i] = (entries[k - 1][i] >> 8) ^ entries[0][entries[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+// tables live in flash, read with pgm_read_* only
+static constexpr CrcTable<uint16_t, CHECKSUM_CRC16_POLY, 1> CRC16_TABLE PROGMEM;
+static constexpr CrcTable<uint32_t, CHECKSUM_CRC32_POLY, 4> CRC32_TABLE PROGMEM;
+
+class Checksum {
+    private:
+    static uint32_t crc32Entry(uint8_t slice, uint8_t index) {
+        return pgm_read_dword(&CRC32_TABLE.entries[slice][index]);
+    }
+
+    public:
+    // CRC-16/MODBUS, one table lookup per byte
+    static uint16_t crc16(const uint8_t *data, size_t size, uint16_t crc = 0xFFFF) {
+        while (size--) {
+            crc = (crc >> 8) ^ pgm_read_word(&CRC16_TABLE.entries[0][(crc ^ *data++) & 0xFF]);
+        }
+        return crc;
+    }
+
+    // CRC-16/MODBUS bit by bit, reference for tables and benchmark
+    static uint16_t crc16Bitwise(const uint8_t *data, size_t size, uint16_t crc = 0xFFFF) {
+        while (size--) {
+            crc ^= *data++;
+            for (uint8_t i = 0; i < 8; ++i) {
+                if (crc & 0x01) {
+                    crc = (crc >> 1) ^ CHECKSUM_CRC16_POLY;
+                }
+                else crc >>= 1;
+            }
+        }
+        return crc;
+    }
+
+    // CRC-32, pass previous result as crc to continue over next chunk
+    static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+        if (size >= CHECKSUM_SLICE_MIN) {
+            return crc32Slice4(data, size, crc);
+        }
+        crc = ~crc;
+        while (size--) {
+            crc = (crc >> 8) ^ crc32Entry(0, crc ^ *data++);
+        }
+        return ~crc;
+    }
+
+    // CRC-32 four bytes per step, for config records, OTA chunks and other larger blobs
+    static uint32_t crc32Slice4(const uint8_t *data, size_t size, uint32_t crc = 0) {
+        crc = ~crc;
+        while (size && ((uintptr_t)data & 3)) {
+            crc = (crc >> 8) ^ crc32Entry(0, crc ^ *data++);
+            size--;
+        }
+        for (; size >= 4; size -= 4, data += 4) {
+            crc ^= *(const uint32_t*)data; // little endian, aligned above
+            crc = crc32Entry(3, crc) ^ crc32Entry(2, crc >> 8) ^ crc32Entry(1, crc >> 16) ^ crc32Entry(0, crc >> 24);
+        }
+        while (size--) {
+            crc = (crc >> 8) ^ crc32Entry(0, crc ^ *data++);
+        }
+        return ~crc;
+    }
+};
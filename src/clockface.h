@@ -0,0 +1,213 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef LED_COUNT
+#define LED_COUNT 60
+#endif
+
+#define IDC_TICKS     0x00
+#define IDC_HOURS_N   0x01
+#define IDC_HOURS_D   0x02
+#define IDC_MINUTES   0x03
+#define IDC_SECONDS   0x04
+
+#define LEDS_PER_HOUR   (LED_COUNT / 12)
+
+#define FACE_CLASSIC    0   // hour marker advances with minutes, blinks with minute marker
+#define FACE_STEPPED    1   // hour marker advances with minutes, nothing blinks
+#define FACE_ROUGH      2   // hour marker jumps on hour change, nothing blinks
+#define FACE_COUNT      3
+
+// Ring geometry lookup tables computed at compile time from LED_COUNT,
+// valid for any ring size (24, 60, 120, 144 ...) not only for 60 leds
+struct ClockGeometry {
+    uint16_t minuteFirst[61];   // first pixel of minute (or second) span, [60] = LED_COUNT
+    uint16_t hourTick[13];      // tick pixel of hour, [12] = LED_COUNT
+    uint16_t hourShift[60];     // hour hand advance in pixels for minute
+    uint8_t hourSegment[24];    // hour hand segment for hour of day
+    bool tick[LED_COUNT];       // pixel is hour tick
+
+    constexpr ClockGeometry() : minuteFirst(), hourTick(), hourShift(), hourSegment(), tick() {
+        for (uint16_t m = 0; m <= 60; m++) {
+            minuteFirst[m] = m * LED_COUNT / 60;
+        }
+        for (uint16_t h = 0; h <= 12; h++) {
+            hourTick[h] = h * LED_COUNT / 12;
+        }
+        for (uint16_t h = 0; h < 12; h++) {
+            tick[hourTick[h]] = true;
+        }
+        for (uint16_t m = 0; m < 60; m++) {
+            hourShift[m] = m * LED_COUNT / 720;
+        }
+        for (uint8_t h = 0; h < 24; h++) {
+            hourSegment[h] = (h + 11) % 12;
+        }
+    }
+
+    // number of pixels in minute span, at least one for rings smaller than 60 leds
+    constexpr uint16_t minuteSpan(uint8_t m) const {
+        return minuteFirst[m + 1] > minuteFirst[m] ? minuteFirst[m + 1] - minuteFirst[m] : 1;
+    }
+};
+
+// Clock face rendering, hardware independent (no Arduino or NeoPixel dependencies)
+// so it can be compiled and checked on host as well as on device
+class ClockFace {
+    protected:
+    static constexpr ClockGeometry GEOMETRY = ClockGeometry();
+
+    static void fill(uint32_t* frame, uint32_t color, uint16_t first, uint16_t count) {
+        for (uint16_t i = first, imax = first + count; i < imax; i++) {
+            frame[i] = color;
+        }
+    }
+
+    static void blendFill(uint32_t* frame, uint32_t color, uint8_t weight, uint16_t first, uint16_t count) {
+        for (uint16_t i = first, imax = first + count; i < imax; i++) {
+            frame[i] = blend(frame[i], color, weight);
+        }
+    }
+
+    public:
+    // per channel linear mix of two colors, weight 0 gives colorA, 255 gives colorB
+    static uint32_t blend(uint32_t colorA, uint32_t colorB, uint8_t weight) {
+        uint32_t result = 0;
+        for (uint8_t shift = 0; shift < 24; shift += 8) {
+            int32_t a = (colorA >> shift) & 0xFF, b = (colorB >> shift) & 0xFF;
+            result |= (uint32_t)(a + (b - a) * weight / 255) << shift;
+        }
+        return result;
+    }
+};
+
+// Face renderer, Face supplies hour marker placement and blinking rules as static
+// members (CRTP) resolved at compile time, so pixel loops have no indirect calls
+template <typename Face>
+class FaceRenderer : public ClockFace {
+    public:
+    // render face for given local time into frame of LED_COUNT pixels
+    static void render(uint32_t* frame, const uint32_t* colors, uint8_t hh, uint8_t mm, uint8_t ss) {
+        // damp non-tick space and draw ticks
+        for (uint16_t i = 0; i < LED_COUNT; i++) {
+            frame[i] = GEOMETRY.tick[i] ? colors[IDC_TICKS] : 0x000000;
+        }
+
+        // draw hour marker, on tick leds only when face allows it
+        const bool onTicks = Face::hourOnTicks(ss);
+        const uint32_t hourColor = (hh < 6 || hh > 17) ? colors[IDC_HOURS_N] : colors[IDC_HOURS_D];
+        uint16_t pixel = Face::hourFirst(hh, mm);
+        for (uint16_t n = Face::hourLength(hh); n; n--, pixel++) {
+            if (pixel >= LED_COUNT) {
+                pixel -= LED_COUNT;
+            }
+            if (onTicks || !GEOMETRY.tick[pixel]) {
+                frame[pixel] = hourColor;
+            }
+        }
+
+        // draw minute marker
+        if (Face::minuteVisible(ss)) {
+            fill(frame, colors[IDC_MINUTES], GEOMETRY.minuteFirst[mm], GEOMETRY.minuteSpan(mm));
+        }
+
+        // draw second marker
+        if (colors[IDC_SECONDS]) {
+            fill(frame, colors[IDC_SECONDS], GEOMETRY.minuteFirst[ss], GEOMETRY.minuteSpan(ss));
+        }
+    }
+
+    // render animated frame with fraction of second (0..255), faces without
+    // animation show static frame
+    static void renderSmooth(uint32_t* frame, const uint32_t* colors, uint8_t hh, uint8_t mm, uint8_t ss, uint8_t) {
+        Face::render(frame, colors, hh, mm, ss);
+    }
+
+    protected:
+    // hour marker spans segment before hour tick and advances with minutes
+    static uint16_t hourFirst(uint8_t hh, uint8_t mm) {
+        return GEOMETRY.hourTick[GEOMETRY.hourSegment[hh]] + 1 + GEOMETRY.hourShift[mm];
+    }
+
+    static uint16_t hourLength(uint8_t hh) {
+        const uint8_t segment = GEOMETRY.hourSegment[hh];
+        return GEOMETRY.hourTick[segment + 1] - GEOMETRY.hourTick[segment];
+    }
+
+    static bool hourOnTicks(uint8_t) {
+        return false;
+    }
+
+    static bool minuteVisible(uint8_t) {
+        return true;
+    }
+};
+
+// hour marker on tick leds and minute marker blink in turns every second
+class ClassicFace : public FaceRenderer<ClassicFace> {
+    friend class FaceRenderer<ClassicFace>;
+
+    static bool hourOnTicks(uint8_t ss) {
+        return ss & 1;
+    }
+
+    static bool minuteVisible(uint8_t ss) {
+        return !(ss & 1);
+    }
+
+    public:
+    // render animated face for local time with fraction of second (0..255): seconds
+    // marker crossfades to next position, hour hand moves continuously and blinking
+    // minute marker and ticks under hour hand fade instead of switching
+    static void renderSmooth(uint32_t* frame, const uint32_t* colors, uint8_t hh, uint8_t mm, uint8_t ss, uint8_t fraction) {
+        const uint8_t pulse = (ss & 1) ? fraction : 255 - fraction; // 255 at even second start
+
+        for (uint16_t i = 0; i < LED_COUNT; i++) {
+            frame[i] = GEOMETRY.tick[i] ? colors[IDC_TICKS] : 0x000000;
+        }
+
+        // hour hand position in 1/256 pixel steps, partially lit pixels at both ends
+        const uint8_t segment = GEOMETRY.hourSegment[hh];
+        const uint32_t hourColor = (hh < 6 || hh > 17) ? colors[IDC_HOURS_N] : colors[IDC_HOURS_D];
+        const uint32_t shift = (((uint32_t)mm * 60 + ss) * 256 + fraction) * LED_COUNT / (720 * 60);
+        const uint16_t length = GEOMETRY.hourTick[segment + 1] - GEOMETRY.hourTick[segment];
+        const uint8_t edge = shift & 0xFF;
+        uint16_t pixel = GEOMETRY.hourTick[segment] + 1 + (shift >> 8);
+        for (uint16_t n = 0; n <= length; n++, pixel++) {
+            if (pixel >= LED_COUNT) {
+                pixel -= LED_COUNT;
+            }
+            uint8_t weight = n == 0 ? 255 - edge : n == length ? edge : 255;
+            if (GEOMETRY.tick[pixel]) {
+                weight = (uint32_t)weight * (255 - pulse) / 255;
+            }
+            frame[pixel] = blend(frame[pixel], hourColor, weight);
+        }
+
+        blendFill(frame, colors[IDC_MINUTES], pulse, GEOMETRY.minuteFirst[mm], GEOMETRY.minuteSpan(mm));
+
+        if (colors[IDC_SECONDS]) {
+            const uint8_t next = ss < 59 ? ss + 1 : 0;
+            blendFill(frame, colors[IDC_SECONDS], 255 - fraction, GEOMETRY.minuteFirst[ss], GEOMETRY.minuteSpan(ss));
+            blendFill(frame, colors[IDC_SECONDS], fraction, GEOMETRY.minuteFirst[next], GEOMETRY.minuteSpan(next));
+        }
+    }
+};
+
+// hour marker moves in steps with minutes, nothing blinks
+class SteppedFace : public FaceRenderer<SteppedFace> {
+};
+
+// hour marker fills segment after hour tick and jumps when hour changes
+class RoughFace : public FaceRenderer<RoughFace> {
+    friend class FaceRenderer<RoughFace>;
+
+    static uint16_t hourFirst(uint8_t hh, uint8_t) {
+        return GEOMETRY.hourTick[hh % 12];
+    }
+
+    static uint16_t hourLength(uint8_t hh) {
+        return GEOMETRY.hourTick[hh % 12 + 1] - GEOMETRY.hourTick[hh % 12];
+    }
+};
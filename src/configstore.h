@@ -0,0 +1,206 @@
+#pragma once
+
+#include <Arduino.h>
+#include <flash_hal.h>
+#include "checksum.h"
+
+extern "C" uint32_t _EEPROM_start;
+
+#define CONFIG_STORE_MAGIC 0xC0F1
+#define CONFIG_STORE_COMMIT 0x600DC0DEUL
+#define CONFIG_STORE_SECTOR_SIZE SPI_FLASH_SEC_SIZE
+#define CONFIG_STORE_PAYLOAD_MAX 512
+#ifndef CONFIG_STORE_SECTOR_A
+#define CONFIG_STORE_SECTOR_A (((uint32_t)&_EEPROM_start - 0x40200000) / SPI_FLASH_SEC_SIZE)
+#endif
+#ifndef CONFIG_STORE_SECTOR_B
+#define CONFIG_STORE_SECTOR_B (CONFIG_STORE_SECTOR_A - 1)
+#endif
+
+// Log-structured configuration store on sector pair: EEPROM sector and free sector
+// right below it (gap between filesystem end and EEPROM in nodemcuv2 4m2m layout).
+// Records are appended with increasing sequence numbers, commit word is written
+// last so torn writes are ignored, sector is erased only when switching to it and
+// the other sector keeps previous record until new one is committed.
+class ConfigStore {
+    private:
+    struct Header {
+        uint16_t magic;
+        uint16_t length;
+        uint32_t sequence;
+        uint16_t crc;
+        uint16_t reserved;
+        uint32_t commit;
+    };
+
+    uint32_t _sectors[2];
+    uint32_t _next[2];          // append offset in sector, SECTOR_SIZE when sector holds foreign data
+    uint8_t _active;            // sector of newest record
+    uint32_t _offset;           // offset of newest record
+    uint32_t _sequence;         // sequence of newest record, zero when store is empty
+    uint16_t _length;
+    uint16_t _crc;
+
+    static uint32_t align(uint32_t size) {
+        return (size + 3) & ~3UL;
+    }
+
+    uint32_t address(uint8_t sector, uint32_t offset) const {
+        return _sectors[sector] * CONFIG_STORE_SECTOR_SIZE + offset;
+    }
+
+    // word aligned buffer for flash transfers shared by all operations, store is
+    // used from loop() only and no operation nests another one
+    static uint32_t* scratch() {
+        static uint32_t words[CONFIG_STORE_PAYLOAD_MAX / 4];
+        return words;
+    }
+
+    // payload of record read into scratch buffer, nullptr on read failure
+    const uint8_t* readPayload(uint8_t sector, uint32_t offset, uint16_t length) const {
+        if (!ESP.flashRead(address(sector, offset + sizeof(Header)), scratch(), align(length))) {
+            return nullptr;
+        }
+        return (const uint8_t*)scratch();
+    }
+
+    void scan(uint8_t sector) {
+        uint32_t offset = 0;
+        while (offset + sizeof(Header) <= CONFIG_STORE_SECTOR_SIZE) {
+            Header header;
+            if (!ESP.flashRead(address(sector, offset), (uint32_t*)&header, sizeof(header))) {
+                break;
+            }
+            if (header.magic == 0xFFFF && header.length == 0xFFFF) {
+                break; // erased space, end of log
+            }
+            if (header.magic != CONFIG_STORE_MAGIC || header.length > CONFIG_STORE_PAYLOAD_MAX) {
+                offset = CONFIG_STORE_SECTOR_SIZE; // foreign data, sector must be erased before use
+                break;
+            }
+
+            if (header.commit == CONFIG_STORE_COMMIT && header.sequence > _sequence) {
+                const uint8_t* data = readPayload(sector, offset, header.length);
+                if (data && Checksum::crc16(data, header.length) == header.crc) {
+                    _active = sector;
+                    _offset = offset;
+                    _sequence = header.sequence;
+                    _length = header.length;
+                    _crc = header.crc;
+                }
+            }
+            offset += sizeof(Header) + align(header.length);
+        }
+        _next[sector] = offset;
+    }
+
+    bool append(uint8_t sector, const uint8_t* data, uint16_t length) {
+        const uint32_t size = sizeof(Header) + align(length);
+        if (_next[sector] + size > CONFIG_STORE_SECTOR_SIZE) {
+            if (!ESP.flashEraseSector(_sectors[sector])) {
+                return false;
+            }
+            _next[sector] = 0;
+        }
+
+        const uint32_t offset = _next[sector];
+        _next[sector] += size; // space is consumed even when write fails halfway
+
+        Header header = { CONFIG_STORE_MAGIC, length, _sequence + 1, Checksum::crc16(data, length), 0xFFFF, 0xFFFFFFFFUL };
+        uint32_t* words = scratch();
+        memset(words, 0xFF, align(length));
+        memcpy(words, data, length);
+        if (!ESP.flashWrite(address(sector, offset), (uint32_t*)&header, sizeof(header)) ||
+                !ESP.flashWrite(address(sector, offset + sizeof(header)), words, align(length))) {
+            return false;
+        }
+
+        // commit: erased commit word is programmed only after payload is complete
+        header.commit = CONFIG_STORE_COMMIT;
+        if (!ESP.flashWrite(address(sector, offset + offsetof(Header, commit)), &header.commit, sizeof(header.commit))) {
+            return false;
+        }
+
+        _active = sector;
+        _offset = offset;
+        _sequence = header.sequence;
+        _length = length;
+        _crc = header.crc;
+        return true;
+    }
+
+    public:
+    ConfigStore(uint32_t sectorA, uint32_t sectorB) : _next(), _active(0), _offset(0), _sequence(0), _length(0), _crc(0) {
+        _sectors[0] = sectorA;
+        _sectors[1] = sectorB;
+    }
+
+    static ConfigStore& instance() {
+        static ConfigStore store(CONFIG_STORE_SECTOR_A, CONFIG_STORE_SECTOR_B);
+        return store;
+    }
+
+    // sectors must lie above filesystem, flash layouts without gap need other sector pair
+    bool isUsable() const {
+        const uint32_t fsEnd = (FS_PHYS_ADDR + FS_PHYS_SIZE + CONFIG_STORE_SECTOR_SIZE - 1) / CONFIG_STORE_SECTOR_SIZE;
+        return FS_PHYS_SIZE == 0 || (_sectors[0] >= fsEnd && _sectors[1] >= fsEnd);
+    }
+
+    // find newest committed record in single pass over both sectors
+    bool begin() {
+        _sequence = 0;
+        _next[0] = _next[1] = CONFIG_STORE_SECTOR_SIZE;
+        if (!isUsable()) {
+            Serial.println("Configuration store overlaps filesystem");
+            return false;
+        }
+        scan(0);
+        scan(1);
+        return true;
+    }
+
+    bool isEmpty() const {
+        return _sequence == 0;
+    }
+
+    uint32_t sequence() const {
+        return _sequence;
+    }
+
+    // payload length of newest record
+    uint16_t length() const {
+        return _length;
+    }
+
+    // read newest record, fails when store is empty or record length differs
+    bool load(void* data, uint16_t length) const {
+        const uint8_t* stored = !isEmpty() && length == _length ? readPayload(_active, _offset, length) : nullptr;
+        if (stored) {
+            memcpy(data, stored, length);
+        }
+        return stored != nullptr;
+    }
+
+    // append record when it differs from newest one, unchanged flag tells write was skipped
+    bool save(const void* data, uint16_t length, bool* unchanged = nullptr) {
+        if (length > CONFIG_STORE_PAYLOAD_MAX || !isUsable()) {
+            return false;
+        }
+        bool same = !isEmpty() && length == _length && Checksum::crc16((const uint8_t*)data, length) == _crc;
+        if (same) {
+            const uint8_t* stored = readPayload(_active, _offset, length);
+            same = stored && memcmp(stored, data, length) == 0;
+        }
+        if (unchanged) {
+            *unchanged = same;
+        }
+        if (same) {
+            return true;
+        }
+
+        // keep appending to active sector while it has room, otherwise switch sectors
+        const uint8_t sector = isEmpty() ? 1 : _active;
+        const uint32_t size = sizeof(Header) + align(length);
+        return append(_next[sector] + size <= CONFIG_STORE_SECTOR_SIZE ? sector : 1 - sector, (const uint8_t*)data, length);
+    }
+};
@@ -2,7 +2,14 @@
 
 #include <Arduino.h>
 #include <EEPROM.h>
+#include <inttypes.h>
 #include "secrets.h"
+#include "timezone.h"
+#include "checksum.h"
+#include "configstore.h"
+#include "brightness.h"
+#include "clockface.h"
+#include "beacon.h"
 
 #ifndef WIFI_SSID
 #error WIFI_SSID constant must be defined in secrets.h file
@@ -24,17 +31,69 @@
 #define COLOR_HOURS_D 0x3333AA
 #define COLOR_MINUTES 0xFF0000
 #define COLOR_SECONDS 0x001100 
+#define DEFAULT_POWER_BUDGET 2000   // mA available to strip from 5 V supply
 
-#define STATE_FORMAT_VERSION 0x0100
+// Stored record is format word at same offset as in raw layouts followed by tagged fields:
+// tag byte, length byte, value.
+// Tags are never reused, new option gets new tag and missing tags keep defaults, so
+// adding field needs no format change. Older raw struct layouts are migrated by table.
+#define STATE_FORMAT_VERSION 0x0200
+#define STATE_RECORD_SIZE CONFIG_STORE_PAYLOAD_MAX
+#define STATE_LEGACY_SIZE 220   // largest raw struct layout, format 0x0102
+
+#define TAG_LEGACY_BRIGHTNESS 1    // linear duty of earlier firmware, converted to level
+#define TAG_FPS          2
+#define TAG_NTP_ENABLED  3
+#define TAG_IP           4
+#define TAG_GATEWAY      5
+#define TAG_SUBNET       6
+#define TAG_DNS          7
+#define TAG_COLORS       8
+#define TAG_WIFI_SSID    9
+#define TAG_WIFI_PASS    10
+#define TAG_TIMESERVER1  11
+#define TAG_TIMESERVER2  12
+#define TAG_TIMESERVER3  13
+#define TAG_TIMEZONE     14
+#define TAG_BRIGHTNESS_MODE  15
+#define TAG_NIGHT_BRIGHTNESS 16
+#define TAG_SENSOR_DARK  17
+#define TAG_SENSOR_BRIGHT    18
+#define TAG_POWER_BUDGET 19
+#define TAG_FACE         20
+#define TAG_BEACON_ROLE  21
+#define TAG_CLOCK_DRIFT  22
+#define TAG_BRIGHTNESS   23     // perceived level through gamma table
+#define TAG_LEGACY_TZ    0xF0   // legacy hours offset and daylight flag, converted to TZ rules
+#define TAG_COUNT        24
+
+struct ConfigField {
+    uint8_t tag;
+    uint8_t size;
+    uint16_t offset;    // offset in Configuration or in legacy layout
+};
+
+// raw struct layout written by earlier firmware, checksum covers all bytes after it
+struct ConfigLayout {
+    uint16_t format;
+    uint16_t size;
+    const ConfigField* fields;
+    uint8_t count;
+};
 
 class Configuration {
     public:
-    uint16_t stateCrc16;    // integrity control checksum
-    uint16_t stateFormat;   // structure format version
     uint8_t displayBrightness;
-    uint8_t timezone;
-    uint8_t daylight;
+    uint8_t displayFps;     // animation frame rate, zero for once per second updates
+    uint8_t displayFace;    // clock face, FACE_CLASSIC ...
     uint8_t ntpenabled;
+    uint8_t brightnessMode;     // manual, ambient sensor or day/night schedule
+    uint8_t nightBrightness;    // brightness at night or in dark room
+    uint16_t sensorDark;        // ambient sensor reading of dark room
+    uint16_t sensorBright;      // ambient sensor reading of lit room
+    uint16_t powerBudget;       // strip current limit, mA, zero for no limit
+    uint8_t beaconRole;         // time beacon leader or follower of clocks in same room
+    int32_t clockDrift;         // learned oscillator frequency error, ppb
     uint32_t stationIP;
     uint32_t stationGateway;
     uint32_t stationSubnet;
@@ -45,35 +104,137 @@ class Configuration {
     char timeServer1[32];
     char timeServer2[32];
     char timeServer3[32];
+    char timezone[TZ_STRING_SIZE];  // POSIX TZ rules
+
+    private:
+    // current fields indexed by tag, retired tags have no size, string fields are stored without terminator
+    static const ConfigField* field(uint8_t tag) {
+        static constexpr ConfigField fields[TAG_COUNT] = {
+            { 0, 0, 0 },
+            { TAG_LEGACY_BRIGHTNESS, 0, 0 },
+            { TAG_FPS,         sizeof(displayFps),        offsetof(Configuration, displayFps) },
+            { TAG_NTP_ENABLED, sizeof(ntpenabled),        offsetof(Configuration, ntpenabled) },
+            { TAG_IP,          sizeof(stationIP),         offsetof(Configuration, stationIP) },
+            { TAG_GATEWAY,     sizeof(stationGateway),    offsetof(Configuration, stationGateway) },
+            { TAG_SUBNET,      sizeof(stationSubnet),     offsetof(Configuration, stationSubnet) },
+            { TAG_DNS,         sizeof(stationDNS),        offsetof(Configuration, stationDNS) },
+            { TAG_COLORS,      sizeof(displayColors),     offsetof(Configuration, displayColors) },
+            { TAG_WIFI_SSID,   sizeof(wifiSSID),          offsetof(Configuration, wifiSSID) },
+            { TAG_WIFI_PASS,   sizeof(wifiPassword),      offsetof(Configuration, wifiPassword) },
+            { TAG_TIMESERVER1, sizeof(timeServer1),       offsetof(Configuration, timeServer1) },
+            { TAG_TIMESERVER2, sizeof(timeServer2),       offsetof(Configuration, timeServer2) },
+            { TAG_TIMESERVER3, sizeof(timeServer3),       offsetof(Configuration, timeServer3) },
+            { TAG_TIMEZONE,    sizeof(timezone),          offsetof(Configuration, timezone) },
+            { TAG_BRIGHTNESS_MODE,  sizeof(brightnessMode),  offsetof(Configuration, brightnessMode) },
+            { TAG_NIGHT_BRIGHTNESS, sizeof(nightBrightness), offsetof(Configuration, nightBrightness) },
+            { TAG_SENSOR_DARK,      sizeof(sensorDark),      offsetof(Configuration, sensorDark) },
+            { TAG_SENSOR_BRIGHT,    sizeof(sensorBright),    offsetof(Configuration, sensorBright) },
+            { TAG_POWER_BUDGET,     sizeof(powerBudget),     offsetof(Configuration, powerBudget) },
+            { TAG_FACE,             sizeof(displayFace),     offsetof(Configuration, displayFace) },
+            { TAG_BEACON_ROLE,      sizeof(beaconRole),      offsetof(Configuration, beaconRole) },
+            { TAG_CLOCK_DRIFT,      sizeof(clockDrift),      offsetof(Configuration, clockDrift) },
+            { TAG_BRIGHTNESS,       sizeof(displayBrightness), offsetof(Configuration, displayBrightness) },
+        };
+        return tag && tag < TAG_COUNT && fields[tag].size ? &fields[tag] : nullptr;
+    }
+
+    static bool isString(uint8_t tag) {
+        return tag >= TAG_WIFI_SSID && tag <= TAG_TIMEZONE;
+    }
+
+    // migration table, each legacy field is mapped to current tag
+    static const ConfigLayout* layout(uint16_t format) {
+        static constexpr ConfigField v0100[] = {
+            { TAG_LEGACY_BRIGHTNESS, 1, 4 }, { TAG_LEGACY_TZ, 2, 5 }, { TAG_NTP_ENABLED, 1, 7 },
+            { TAG_IP, 4, 8 }, { TAG_GATEWAY, 4, 12 }, { TAG_SUBNET, 4, 16 }, { TAG_DNS, 4, 20 },
+            { TAG_COLORS, 20, 24 }, { TAG_WIFI_SSID, 16, 44 }, { TAG_WIFI_PASS, 16, 60 },
+            { TAG_TIMESERVER1, 32, 76 }, { TAG_TIMESERVER2, 32, 108 }, { TAG_TIMESERVER3, 32, 140 },
+        };
+        static constexpr ConfigField v0101[] = {
+            { TAG_LEGACY_BRIGHTNESS, 1, 4 }, { TAG_FPS, 1, 5 }, { TAG_LEGACY_TZ, 2, 6 }, { TAG_NTP_ENABLED, 1, 8 },
+            { TAG_IP, 4, 12 }, { TAG_GATEWAY, 4, 16 }, { TAG_SUBNET, 4, 20 }, { TAG_DNS, 4, 24 },
+            { TAG_COLORS, 20, 28 }, { TAG_WIFI_SSID, 16, 48 }, { TAG_WIFI_PASS, 16, 64 },
+            { TAG_TIMESERVER1, 32, 80 }, { TAG_TIMESERVER2, 32, 112 }, { TAG_TIMESERVER3, 32, 144 },
+        };
+        static constexpr ConfigField v0102[] = {
+            { TAG_LEGACY_BRIGHTNESS, 1, 4 }, { TAG_FPS, 1, 5 }, { TAG_NTP_ENABLED, 1, 6 },
+            { TAG_IP, 4, 8 }, { TAG_GATEWAY, 4, 12 }, { TAG_SUBNET, 4, 16 }, { TAG_DNS, 4, 20 },
+            { TAG_COLORS, 20, 24 }, { TAG_WIFI_SSID, 16, 44 }, { TAG_WIFI_PASS, 16, 60 },
+            { TAG_TIMESERVER1, 32, 76 }, { TAG_TIMESERVER2, 32, 108 }, { TAG_TIMESERVER3, 32, 140 },
+            { TAG_TIMEZONE, 48, 172 },
+        };
+        static constexpr ConfigLayout layouts[] = {
+            { 0x0100, 172, v0100, sizeof(v0100) / sizeof(ConfigField) },
+            { 0x0101, 176, v0101, sizeof(v0101) / sizeof(ConfigField) },
+            { 0x0102, STATE_LEGACY_SIZE, v0102, sizeof(v0102) / sizeof(ConfigField) },
+        };
+        for (const ConfigLayout& l : layouts) {
+            if (l.format == format) {
+                return &l;
+            }
+        }
+        return nullptr;
+    }
 
+    // copy value into field, shorter values are zero extended and longer ones truncated
+    void apply(uint8_t tag, const uint8_t* value, uint8_t length) {
+        if (tag == TAG_LEGACY_TZ && length == 2) {
+            // hours offset and daylight flag used to set fixed offset
+            int hours = (int8_t)value[0] + (value[1] ? 1 : 0);
+            if (hours) {
+                snprintf(timezone, sizeof(timezone), "<%+03d>%d", hours, -hours);
+            }
+            else strcpy(timezone, "UTC0");
+            return;
+        }
+        if (tag == TAG_LEGACY_BRIGHTNESS && length == 1) {
+            displayBrightness = AutoBrightness::fromLinear(value[0]);
+            return;
+        }
+
+        const ConfigField* f = field(tag);
+        if (!f) {
+            return; // unknown tag written by newer firmware
+        }
+        uint8_t* dest = (uint8_t*)this + f->offset;
+        memset(dest, 0, f->size);
+        memcpy(dest, value, length < f->size ? length : f->size);
+        if (isString(tag)) {
+            dest[f->size - 1] = 0;
+        }
+    }
+
+    public:
     Configuration() {
         memset(this, 0, sizeof(Configuration));
     }
 
     bool loadStoredConfigurationOrDefaults() {
+        loadDefaults();
+        if (loadFromStore()) {
+            Serial.println("Configuration loaded");
+            return true;
+        }
         if (loadFromEEPROM()) {
-            if(checkIntegrity()) {
-                if(checkFormatVersion()) {
-                    Serial.println("Configuration loaded");
-                    return true;
-                }
-                else Serial.println("Configuration load failed (version mismatch)");
-            }
-            else Serial.println("Configuration load failed (invalid checksum)");
+            Serial.println("Configuration migrated from EEPROM layout");
+            return true;
         }
-        else Serial.println("Configuration load failed (EEPROM error)");
-
-        loadDefaults();
         Serial.println("Loaded default configuration");
         return false;
     }
 
     void loadDefaults() {
-        stateFormat = STATE_FORMAT_VERSION;
-        displayBrightness = 50;
-        timezone = 3;
-        daylight = 0;
+        displayBrightness = AutoBrightness::fromLinear(50);
+        displayFps = 0;
+        displayFace = FACE_CLASSIC;
         ntpenabled = 1;
+        brightnessMode = BRIGHTNESS_MANUAL;
+        nightBrightness = 10;
+        sensorDark = 20;
+        sensorBright = 600;
+        powerBudget = DEFAULT_POWER_BUDGET;
+        beaconRole = BEACON_OFF;
+        clockDrift = 0;
         stationIP = DEFAULT_IP_ADDRESS;
         stationGateway = DEFAULT_GATEWAY;
         stationSubnet = DEFAULT_SUBNET;
@@ -88,44 +249,102 @@ class Configuration {
         strcpy(timeServer1, "0.pool.ntp.org");
         strcpy(timeServer2, "1.pool.ntp.org");
         strcpy(timeServer3, "time.nist.gov");
+        strcpy(timezone, TZ_DEFAULT);
     }
 
-    bool loadFromEEPROM() {
-        EEPROM.begin(sizeof(Configuration));
-        EEPROM.get(0, *this);
-        return EEPROM.end();
+    // decode tagged record over current values, fields missing in record keep their values
+    bool deserialize(const uint8_t* data, uint16_t length) {
+        if (length < 4 || (data[2] | data[3] << 8) != STATE_FORMAT_VERSION) {
+            return false;
+        }
+        for (uint16_t i = 4; i + 2 <= length && i + 2 + data[i + 1] <= length; i += 2 + data[i + 1]) {
+            apply(data[i], data + i + 2, data[i + 1]);
+        }
+        return true;
+    }
+
+    // encode tagged record, returns its length or zero when buffer is too small
+    uint16_t serialize(uint8_t* data, uint16_t size) const {
+        uint16_t length = 4;
+        data[0] = data[1] = 0;
+        data[2] = STATE_FORMAT_VERSION & 0xFF;
+        data[3] = STATE_FORMAT_VERSION >> 8;
+        for (uint8_t tag = 1; tag < TAG_COUNT; tag++) {
+            const ConfigField* f = field(tag);
+            if (!f) {
+                continue;
+            }
+            const uint8_t* value = (const uint8_t*)this + f->offset;
+            const uint8_t len = isString(tag) ? strnlen((const char*)value, f->size - 1) : f->size;
+            if (length + 2 + len > size) {
+                return 0;
+            }
+            data[length++] = tag;
+            data[length++] = len;
+            memcpy(data + length, value, len);
+            length += len;
+        }
+        return length;
     }
 
-    bool saveToEEPROM() {
-        stateFormat = STATE_FORMAT_VERSION;
-        stateCrc16 = calculateChecksum();
-        EEPROM.begin(sizeof(Configuration));
-        EEPROM.put(0, *this);
-        return EEPROM.end();
+    // upgrade raw struct layout of earlier firmware field by field
+    bool migrate(const uint8_t* data, uint16_t length) {
+        const ConfigLayout* l = length >= 4 ? layout(data[2] | data[3] << 8) : nullptr;
+        if (!l || length < l->size || (data[0] | data[1] << 8) != crc16(data + 2, l->size - 2)) {
+            return false;
+        }
+        for (uint8_t i = 0; i < l->count; i++) {
+            apply(l->fields[i].tag, data + l->fields[i].offset, l->fields[i].size);
+        }
+        Serial.printf("Configuration format %04X migrated\n", l->format);
+        return true;
+    }
+
+    // newest record of journaled configuration store, tagged or raw layout
+    bool loadFromStore() {
+        ConfigStore& store = ConfigStore::instance();
+        uint8_t data[STATE_RECORD_SIZE];
+        if (!store.begin() || store.length() > sizeof(data) || !store.load(data, store.length())) {
+            return false;
+        }
+        Serial.printf("Configuration record #%" PRIu32 "\n", store.sequence());
+        return deserialize(data, store.length()) || migrate(data, store.length());
     }
 
-    bool checkFormatVersion() {
-        return stateFormat == STATE_FORMAT_VERSION;
+    // single-slot layout written by earlier firmware, read once until store has first record
+    bool loadFromEEPROM() {
+        uint8_t data[STATE_LEGACY_SIZE];
+        EEPROM.begin(sizeof(data));
+        memcpy(data, EEPROM.getConstDataPtr(), sizeof(data));
+        EEPROM.end();
+        return migrate(data, sizeof(data));
     }
 
-    bool checkIntegrity() {
-        return stateCrc16 == calculateChecksum();
+    // append configuration record, flash is not touched when nothing changed since last save
+    bool saveToStore(bool* unchanged = nullptr) {
+        uint8_t data[STATE_RECORD_SIZE];
+        const uint16_t length = serialize(data, sizeof(data));
+        return length && ConfigStore::instance().save(data, length, unchanged);
+    }
+
+    // update learned drift in stored configuration, other settings changed but
+    // not saved yet stay unsaved
+    bool saveClockDrift(int32_t drift) {
+        clockDrift = drift;
+        Configuration stored;
+        stored.loadDefaults();
+        if (!stored.loadFromStore()) {
+            stored.loadFromEEPROM();
+        }
+        stored.clockDrift = drift;
+        return stored.saveToStore();
     }
 
     uint16_t calculateChecksum() {
-        return crc16(((uint8_t *)this) + sizeof(stateCrc16), sizeof(Configuration) - sizeof(stateCrc16));
+        return crc16((const uint8_t*)this, sizeof(Configuration));
     }
 
     static uint16_t crc16(const uint8_t *data, uint16_t size, uint16_t crc = 0xFFFF) {
-        while (size--) {
-            crc ^= *data++;
-            for (uint8_t i = 0; i < 8; ++i) {
-                if (crc & 0x01) {
-                    crc = (crc >> 1) ^ 0xA001;
-                }
-                else crc >>= 1;
-            }
-        }
-        return crc;
+        return Checksum::crc16(data, size, crc);
     }
-};
\ No newline at end of file
+};
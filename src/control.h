@@ -0,0 +1,357 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <inttypes.h>
+#include <bearssl/bearssl.h>
+#include <functional>
+#include "checksum.h"
+#include "mytime.h"
+
+#define CONTROL_PORT 7373
+#define CONTROL_MULTICAST_IP IPAddress(239, 255, 72, 67)
+#define CONTROL_MAGIC 0x4348            // "HC"
+#define CONTROL_VERSION 2
+#define CONTROL_PACKET_MAX 512
+#define CONTROL_REPLY_MAX 128
+#define CONTROL_HEADER_SIZE 16          // magic, version, flags, sequence, time, target
+#define CONTROL_MAC_SIZE 16             // HMAC-SHA256 truncated to 128 bits
+#define CONTROL_KEY_MIN 16
+#define CONTROL_COMMANDS_MAX 32         // results of batch fit into 32 bit mask
+#define CONTROL_TIME_WINDOW_S 300       // packet time must be this close to valid local clock
+#define CONTROL_RTC_MAGIC 0x43544C53    // "CTLS"
+#define CONTROL_RTC_OFFSET 40           // RTC user memory block after drift record
+
+#define CONTROL_FLAG_ACK   0x01         // request result reply
+#define CONTROL_FLAG_REPLY 0x80         // packet sent by clock
+
+// commands, payload sizes in bytes
+#define CONTROL_SET_SCHEME     1        // brightness, 5 colors RGB = 16
+#define CONTROL_SET_TIME       2        // Unix seconds, microseconds = 8
+#define CONTROL_SET_BRIGHTNESS 3        // brightness = 1, + mode, night, dark, bright = 7
+#define CONTROL_COMMIT         4        // save configuration = 0
+#define CONTROL_QUERY          5        // reply with state = 0
+#define CONTROL_RESULT         0x81     // reply: commands, failed mask, truncated mask = 9
+#define CONTROL_RESULT_SIZE    11
+#define CONTROL_STATE          0x85     // reply: state written by command handler
+
+// Command of received packet, payload points into packet buffer, multi-byte
+// fields are little endian and read bytewise as they are not aligned
+struct ControlCommand {
+    uint8_t op;
+    uint8_t length;
+    const uint8_t* payload;
+
+    uint8_t u8(uint8_t at) const {
+        return payload[at];
+    }
+
+    uint16_t u16(uint8_t at) const {
+        return payload[at] | (uint16_t)payload[at + 1] << 8;
+    }
+
+    uint32_t u32(uint8_t at) const {
+        return u16(at) | (uint32_t)u16(at + 2) << 16;
+    }
+
+    uint32_t rgb(uint8_t at) const {
+        return (uint32_t)payload[at] << 16 | (uint32_t)payload[at + 1] << 8 | payload[at + 2];
+    }
+};
+
+// Builds authenticated packet in caller buffer: header, commands, MAC
+class ControlWriter {
+    private:
+    uint8_t* _buf;
+    size_t _size;
+    size_t _len;
+    bool _overflow;
+
+    public:
+    ControlWriter(uint8_t* buf, size_t size, uint8_t flags, uint32_t sequence, uint32_t time, uint32_t target)
+        : _buf(buf), _size(size), _len(0), _overflow(false) {
+        u16(CONTROL_MAGIC).u8(CONTROL_VERSION).u8(flags).u32(sequence).u32(time).u32(target);
+    }
+
+    ControlWriter& u8(uint8_t value) {
+        if (_len < _size) {
+            _buf[_len++] = value;
+        }
+        else _overflow = true;
+        return *this;
+    }
+
+    ControlWriter& u16(uint16_t value) {
+        return u8(value).u8(value >> 8);
+    }
+
+    ControlWriter& u32(uint32_t value) {
+        return u16(value).u16(value >> 16);
+    }
+
+    ControlWriter& rgb(uint32_t color) {
+        return u8(color >> 16).u8(color >> 8).u8(color);
+    }
+
+    // start command, payload written by following calls must have given length
+    ControlWriter& command(uint8_t op, uint8_t length) {
+        return u8(op).u8(length);
+    }
+
+    // append MAC, returns packet length or 0 when buffer was too small
+    size_t finish(const br_hmac_key_context& key);
+
+    size_t length() const {
+        return _len;
+    }
+
+    bool overflow() const {
+        return _overflow;
+    }
+
+    // drop everything written after given length
+    void rewind(size_t length) {
+        _len = length;
+        _overflow = false;
+    }
+
+    // change buffer size, writing stays within buffer given to constructor
+    void resize(size_t size) {
+        _size = size;
+    }
+};
+
+// Compact binary control protocol for configuring many clocks with one packet.
+// Packets go to CONTROL_PORT by unicast or CONTROL_MULTICAST_IP and carry batch
+// of commands, HMAC over whole packet with shared key authenticates the sender.
+// Replays are rejected by sequence number above the last accepted one, kept in
+// RTC memory over resets, and by sender time that must be within
+// CONTROL_TIME_WINDOW_S of local clock once it is valid, which covers power loss.
+// Packet is validated completely before first command is applied, decoding works
+// in place in static receive buffer.
+//
+// Packet: magic u16, version u8, flags u8, sequence u32, sender Unix time u32,
+// target chip id u32 (0 for all clocks), commands { op u8, length u8, payload },
+// MAC 16 bytes. Reply has the same layout, command replies that do not fit are
+// left out and reported in truncated mask of CONTROL_RESULT.
+class ControlServer {
+    public:
+    typedef std::function<bool(const ControlCommand& command, ControlWriter& reply)> Handler;
+
+    private:
+    WiFiUDP* _udp;
+    bool _udpSetup;
+    uint32_t _udpAddress;           // station address multicast group was joined on
+    bool _enabled;
+    br_hmac_key_context _key;
+    Handler _handler;
+    uint32_t _sequence;             // last accepted
+    uint32_t _accepted;
+    uint32_t _rejected;
+    uint8_t _packet[CONTROL_PACKET_MAX];
+    uint8_t _reply[CONTROL_REPLY_MAX];
+
+    struct RtcRecord {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t crc;
+    };
+
+    static uint32_t read32(const uint8_t* p) {
+        return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    static bool validLength(uint8_t op, uint8_t length) {
+        switch (op) {
+            case CONTROL_SET_SCHEME:     return length == 16;
+            case CONTROL_SET_TIME:       return length == 8;
+            case CONTROL_SET_BRIGHTNESS: return length == 1 || length == 7;
+            case CONTROL_COMMIT:
+            case CONTROL_QUERY:          return length == 0;
+            default:                     return false;
+        }
+    }
+
+    static bool equalMac(const uint8_t* a, const uint8_t* b) {
+        uint8_t diff = 0;
+        for (uint8_t i = 0; i < CONTROL_MAC_SIZE; i++) {
+            diff |= a[i] ^ b[i];
+        }
+        return diff == 0;
+    }
+
+    public:
+    // MAC of data with key, CONTROL_MAC_SIZE bytes written to out
+    static void mac(const br_hmac_key_context& key, const uint8_t* data, size_t len, uint8_t* out) {
+        br_hmac_context ctx;
+        br_hmac_init(&ctx, &key, CONTROL_MAC_SIZE);
+        br_hmac_update(&ctx, data, len);
+        br_hmac_out(&ctx, out);
+    }
+
+    static bool initKey(br_hmac_key_context& key, const char* secret) {
+        if (strlen(secret) < CONTROL_KEY_MIN) {
+            return false;
+        }
+        br_hmac_key_init(&key, &br_sha256_vtable, secret, strlen(secret));
+        return true;
+    }
+
+    // commands of authenticated packet addressed to chip, false for packet
+    // that must be ignored; sender time is checked when local time is valid
+    static bool decode(const br_hmac_key_context& key, const uint8_t* packet, size_t len,
+            uint32_t chip, uint32_t lastSequence, time_t now, ControlCommand* commands, uint8_t& count) {
+        if (len < CONTROL_HEADER_SIZE + CONTROL_MAC_SIZE ||
+                (packet[0] | packet[1] << 8) != CONTROL_MAGIC || packet[2] != CONTROL_VERSION ||
+                (packet[3] & CONTROL_FLAG_REPLY)) {
+            return false;
+        }
+        const size_t end = len - CONTROL_MAC_SIZE;
+        uint8_t expected[CONTROL_MAC_SIZE];
+        mac(key, packet, end, expected);
+        if (!equalMac(expected, packet + end) || read32(packet + 4) <= lastSequence) {
+            return false;
+        }
+        const int64_t skew = (int64_t)read32(packet + 8) - now;
+        if (now >= TIME_VALID_SINCE && (skew > CONTROL_TIME_WINDOW_S || skew < -CONTROL_TIME_WINDOW_S)) {
+            return false;
+        }
+        const uint32_t target = read32(packet + 12);
+        if (target && target != chip) {
+            return false;
+        }
+
+        count = 0;
+        for (size_t at = CONTROL_HEADER_SIZE; at < end; ) {
+            if (end - at < 2 || count == CONTROL_COMMANDS_MAX) {
+                return false;
+            }
+            ControlCommand& command = commands[count++];
+            command.op = packet[at];
+            command.length = packet[at + 1];
+            command.payload = packet + at + 2;
+            at += 2 + command.length;
+            if (at > end || !validLength(command.op, command.length)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ControlServer(WiFiUDP& udp) : _udp(&udp), _udpSetup(false), _udpAddress(0), _enabled(false), _key(),
+        _sequence(0), _accepted(0), _rejected(0) {
+    }
+
+    // enable with shared key of at least CONTROL_KEY_MIN characters, handler applies commands
+    bool begin(const char* secret, Handler handler) {
+        _enabled = initKey(_key, secret);
+        _handler = handler;
+        RtcRecord record;
+        if (ESP.rtcUserMemoryRead(CONTROL_RTC_OFFSET, (uint32_t*)&record, sizeof(record)) &&
+                record.magic == CONTROL_RTC_MAGIC && record.crc == crc(record)) {
+            _sequence = record.sequence;
+        }
+        if (!_enabled) {
+            Serial.println("Control key too short, UDP control disabled");
+        }
+        return _enabled;
+    }
+
+    // poll from loop(), multicast group is joined once station is connected and
+    // again after reconnect or address change, old membership is lost with interface
+    void poll(bool connected) {
+        if (!_enabled) {
+            return;
+        }
+        if (_udpSetup && (!connected || (uint32_t)WiFi.localIP() != _udpAddress)) {
+            _udp->stop();
+            _udpSetup = false;
+        }
+        if (!connected) {
+            return;
+        }
+        if (!_udpSetup) {
+            _udpAddress = WiFi.localIP();
+            _udpSetup = _udp->beginMulticast(WiFi.localIP(), CONTROL_MULTICAST_IP, CONTROL_PORT);
+            return;
+        }
+        int size;
+        while ((size = _udp->parsePacket()) > 0) {
+            if (size > CONTROL_PACKET_MAX) {
+                _udp->flush();
+                _rejected++;
+                continue;
+            }
+            _udp->read(_packet, size);
+            receive(size);
+        }
+    }
+
+    uint32_t getAccepted() const {
+        return _accepted;
+    }
+
+    uint32_t getRejected() const {
+        return _rejected;
+    }
+
+    private:
+    static uint32_t crc(const RtcRecord& record) {
+        return Checksum::crc32((const uint8_t*)&record, offsetof(RtcRecord, crc));
+    }
+
+    void receive(size_t size) {
+        ControlCommand commands[CONTROL_COMMANDS_MAX];
+        uint8_t count;
+        if (!decode(_key, _packet, size, ESP.getChipId(), _sequence, time(NULL), commands, count)) {
+            _rejected++;
+            return;
+        }
+        _sequence = read32(_packet + 4);
+        _accepted++;
+        // accepted sequence survives software and watchdog resets
+        RtcRecord record = { CONTROL_RTC_MAGIC, _sequence, 0 };
+        record.crc = crc(record);
+        ESP.rtcUserMemoryWrite(CONTROL_RTC_OFFSET, (uint32_t*)&record, sizeof(record));
+
+        // handlers write into space left after result command and MAC
+        ControlWriter reply(_reply, sizeof(_reply) - CONTROL_RESULT_SIZE - CONTROL_MAC_SIZE,
+            CONTROL_FLAG_REPLY, _sequence, time(NULL), ESP.getChipId());
+        bool answer = _packet[3] & CONTROL_FLAG_ACK;
+        uint32_t failed = 0, truncated = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            answer |= commands[i].op == CONTROL_QUERY;
+            const size_t mark = reply.length();
+            if (!_handler(commands[i], reply)) {
+                failed |= 1UL << i;
+            }
+            if (reply.overflow()) {
+                reply.rewind(mark);
+                truncated |= 1UL << i;
+            }
+        }
+        reply.resize(sizeof(_reply));
+        reply.command(CONTROL_RESULT, 9).u8(count).u32(failed).u32(truncated);
+        Serial.printf("Control packet %" PRIu32 ": %u commands, failed mask %" PRIx32 "\n", _sequence, count, failed);
+        if (truncated) {
+            Serial.printf("Control reply truncated, mask %" PRIx32 "\n", truncated);
+        }
+
+        const size_t len = reply.finish(_key);
+        if (answer && len) {
+            _udp->beginPacket(_udp->remoteIP(), _udp->remotePort());
+            _udp->write(_reply, len);
+            _udp->endPacket();
+        }
+    }
+};
+
+inline size_t ControlWriter::finish(const br_hmac_key_context& key) {
+    if (_overflow || _size - _len < CONTROL_MAC_SIZE) {
+        return 0;
+    }
+    ControlServer::mac(key, _buf, _len, _buf + _len);
+    _len += CONTROL_MAC_SIZE;
+    return _len;
+}
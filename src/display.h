@@ -2,11 +2,32 @@
 
 #include <time.h>
 #include <Arduino.h>
+#ifdef LED_OUTPUT_I2S
+#include "i2sstrip.h"
+#else
 #include <Adafruit_NeoPixel.h> 
+#endif
+#include "clockface.h"
+#include "effects.h"
+#include "brightness.h"
+#include "mytime.h"
+#include "metrics.h"
+
+#ifdef LED_OUTPUT_I2S
+typedef I2sStrip LedStrip;      // DMA output on GPIO3 (RX), LED_PIN is not used
+#define LED_STRIP_INIT LED_COUNT
+#else
+typedef Adafruit_NeoPixel LedStrip;
+#define LED_STRIP_INIT LED_COUNT, LED_PIN, NEO_GRB + NEO_KHZ800
+#endif
 
 #define LED_PIN   4
-#define LED_COUNT 60 
 #define LED_BRIGHTNESS 50
+#define COLOR_SCHEME_SIZE (5 * 6 + 1)
+#define ANIMATION_FPS_MAX 60
+#define COLOR_WAIT_TICKS 0x0B0800
+#define POWER_CHANNEL_MA 20     // WS2812B current of one channel at full duty
+#define POWER_IDLE_UA 1000      // WS2812B quiescent current per led, uA
 
 // #define COLOR_TICKS   0x0B0A00 //0x080822
 // #define COLOR_HOURS_N 0x000044
@@ -14,22 +35,162 @@
 // #define COLOR_MINUTES 0xFF0000
 // #define COLOR_SECONDS 0x001100 
 
-#define IDC_TICKS     0x00
-#define IDC_HOURS_N   0x01
-#define IDC_HOURS_D   0x02
-#define IDC_MINUTES   0x03
-#define IDC_SECONDS   0x04
-
-#define LEDS_PER_HOUR   (LED_COUNT / 12)
-#define LEDS_PER_MINUTE (LED_COUNT / 60) 
-
 class ClockDisplay {
     private:
-    Adafruit_NeoPixel _strip;
+    LedStrip _strip;
     uint32_t _colors[5];
+    uint8_t _brightness;            // configured brightness, day level of automatic modes
+    uint8_t _level;                 // brightness level applied to strip
+    uint16_t _scale[3];             // gamma corrected channel scales of applied level
+    uint32_t _nextLevel;            // brightness update deadline, millis()
+    AutoBrightness _auto;
+    uint16_t _powerBudget;          // strip current limit, mA, zero for no limit
+    uint16_t _current;              // estimated current of last frame, mA
+    uint16_t _peakCurrent;          // highest estimated frame current, mA
+    uint32_t _limitedFrames;        // frames scaled down to power budget
+    Histogram _renderTime;          // clock face rendering time
+    Histogram _showTime;            // strip output time
+    uint32_t _frame[LED_COUNT];     // frame being rendered
+    uint32_t _shown[LED_COUNT];     // last pixels sent to strip, scaled and limited
+    bool _invalid;                  // strip content does not match _shown
+    uint16_t _changed;              // pixels changed by last frame
+    uint8_t _fps;                   // animation frame rate, zero for once per second updates
+    uint16_t _frameInterval;        // animation frame interval, ms
+    uint32_t _nextFrame;            // animation frame deadline, millis()
+    uint32_t _statsStart;           // animation statistics window start, millis()
+    uint16_t _statsFrames;          // frames rendered in statistics window
+    uint16_t _fpsAchieved;          // frames per second rendered in last window
+    uint32_t _dropped;              // animation frames dropped due to missed deadlines
+    time_t _prevTime;               // time of last once per second update
+    uint8_t _face;                  // clock face, FACE_CLASSIC ...
+    DisplayEffect _effect;          // running effect, takes over clock face while active
+    uint32_t _waitColor;            // blink color while time is not set
+
+    // scale pixel channels by gamma corrected level, channel that is set never goes dark
+    uint32_t scaleColor(uint32_t color) {
+        uint32_t result = 0;
+        for (uint8_t c = 0; c < 3; c++) {
+            const uint8_t shift = 16 - c * 8;
+            const uint8_t value = color >> shift;
+            uint32_t scaled = ((uint32_t)value * _scale[c] + 0x8000) >> 16;
+            if (!scaled && value && _scale[c]) {
+                scaled = 1;
+            }
+            result |= scaled << shift;
+        }
+        return result;
+    }
+
+    void applyLevel(uint8_t level) {
+        _level = level;
+        for (uint8_t c = 0; c < 3; c++) {
+            _scale[c] = AutoBrightness::scale(c, level);
+        }
+    }
+
+    // estimated strip current for sum of all channel values
+    static uint16_t estimateCurrent(uint32_t channels) {
+        return (LED_COUNT * POWER_IDLE_UA + 500) / 1000 + channels * POWER_CHANNEL_MA / 255;
+    }
+
+    static uint32_t channelSum(uint32_t color) {
+        return (color >> 16 & 0xFF) + (color >> 8 & 0xFF) + (color & 0xFF);
+    }
+
+    // scale pixels down so estimated current fits power budget, returns new channel sum
+    uint32_t powerLimit(uint32_t* pixels, uint32_t channels) {
+        if (!channels) {
+            return 0;
+        }
+        const int32_t available = (int32_t)_powerBudget - estimateCurrent(0);
+        const uint32_t allowed = available > 0 ? (uint32_t)available * 255 / POWER_CHANNEL_MA : 0;
+        const uint32_t factor = ((uint64_t)allowed << 16) / channels;
+        channels = 0;
+        for (uint16_t i = 0; i < LED_COUNT; i++) {
+            uint32_t color = 0;
+            for (uint8_t shift = 0; shift <= 16; shift += 8) {
+                color |= (((pixels[i] >> shift & 0xFF) * factor) >> 16) << shift;
+            }
+            channels += channelSum(pixels[i] = color);
+        }
+        return channels;
+    }
+
+    // follow brightness source, strip is refreshed when level changes
+    void brightnessPoll() {
+        const uint32_t now = millis();
+        if ((int32_t)(now - _nextLevel) < 0) {
+            return;
+        }
+        _nextLevel = now + BRIGHTNESS_POLL_MS;
+
+        const time_t t = time(NULL);
+        const uint8_t hh = t < TIME_VALID_SINCE ? 12 : LocalTime::at(t).tm_hour;
+        const uint8_t level = _auto.update(_brightness, hh);
+        if (level != _level) {
+            applyLevel(level);
+            frameUpdate();
+        }
+    }
+
+    // face is selected once per frame, renderers are specialised at compile time
+    void renderFace(const tm& lct, uint8_t fraction, bool animated) {
+        const uint32_t start = micros();
+        switch (_face) {
+            case FACE_STEPPED:
+                render<SteppedFace>(lct, fraction, animated);
+                break;
+            case FACE_ROUGH:
+                render<RoughFace>(lct, fraction, animated);
+                break;
+            default:
+                render<ClassicFace>(lct, fraction, animated);
+        }
+        _renderTime.record(micros() - start);
+    }
+
+    template <typename Face>
+    void render(const tm& lct, uint8_t fraction, bool animated) {
+        if (animated) {
+            Face::renderSmooth(_frame, _colors, lct.tm_hour, lct.tm_min, lct.tm_sec, fraction);
+        }
+        else Face::render(_frame, _colors, lct.tm_hour, lct.tm_min, lct.tm_sec);
+    }
+
+    // render animated frame when deadline is reached, late frames are dropped
+    // instead of rendered back to back so loop() keeps its time for network
+    void animationPoll() {
+        const uint32_t now = millis();
+        if ((int32_t)(now - _nextFrame) < 0) {
+            return;
+        }
+
+        const uint32_t late = now - _nextFrame;
+        if (late >= _frameInterval) {
+            _dropped += late / _frameInterval;
+            _nextFrame = now + _frameInterval;
+        }
+        else _nextFrame += _frameInterval;
+
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        const tm& lct = LocalTime::at(tv.tv_sec);
+        renderFace(lct, tv.tv_usec * 256 / 1000000, true);
+        frameUpdate();
+
+        _statsFrames++;
+        if (now - _statsStart >= 1000) {
+            _fpsAchieved = ((uint32_t)_statsFrames * 1000 + 500) / (now - _statsStart);
+            _statsStart = now;
+            _statsFrames = 0;
+        }
+    }
 
     public:
-    ClockDisplay() : _strip(LED_COUNT, LED_PIN, NEO_GRB + NEO_KHZ800) {
+    ClockDisplay() : _strip(LED_STRIP_INIT), _brightness(0), _level(0), _scale(), _nextLevel(0),
+            _powerBudget(0), _current(0), _peakCurrent(0), _limitedFrames(0), _invalid(true), _changed(0),
+            _fps(0), _frameInterval(0), _nextFrame(0), _statsStart(0), _statsFrames(0), _fpsAchieved(0), _dropped(0),
+            _prevTime(0), _face(FACE_CLASSIC), _waitColor(0) {
        // resetColors();
     }
 
@@ -47,54 +208,228 @@ class ClockDisplay {
     }
 
     void draw(uint32_t colorF, uint32_t colorT, uint16_t start = 0, uint16_t count = 0) {
-        const uint16_t numpix = _strip.numPixels();
-        for (uint16_t i = 0, imax = count ? count : numpix; i < imax; ++i) {
-            _strip.setPixelColor((i + start) % numpix, i % LEDS_PER_HOUR ? colorF : colorT);
+        for (uint16_t i = 0, imax = count ? count : LED_COUNT; i < imax; ++i) {
+            _frame[(i + start) % LED_COUNT] = i % LEDS_PER_HOUR ? colorF : colorT;
         }
-        _strip.show();
+        frameUpdate();
+    }
+
+    // start effect, it runs from poll() and hands display back to clock face when finished
+    void startEffect(uint8_t effect, uint8_t next = EFFECT_NONE) {
+        _effect.start(effect, millis(), next);
     }
 
+    // run color test without blocking
     void test() {
-        uint32_t colors[] = { 0xFF0000, 0x00FF00, 0x0000FF, 0xFFFFFF };
-        for (unsigned int i = 0; i < sizeof(colors) / sizeof(uint32_t); ++i) {
-            _strip.fill(colors[i], 0, LED_COUNT);
-            _strip.show();
-            delay(1000);
-        }
-        _strip.clear();
-        _strip.show();
+        startEffect(EFFECT_TEST);
+    }
+
+    // set blink color shown while time is not set
+    void setWaitColor(uint32_t color) {
+        _waitColor = color;
     }
 
     // poll to update clock display
     void poll() {
-        static time_t prevt;
+#ifdef LED_OUTPUT_I2S
+        _strip.poll();
+#endif
+        brightnessPoll();
+
+        if (_effect.active()) {
+            if (_effect.render(_frame, _colors, millis())) {
+                frameUpdate();
+                return;
+            }
+            _prevTime = 0; // effect finished, redraw clock face
+        }
+
         time_t t = time(NULL);
-        if (prevt != t) {
-            stripUpdate(prevt = t);
+        if (t < TIME_VALID_SINCE) {
+            draw(t % 2 ? _waitColor : 0x000000, COLOR_WAIT_TICKS);
+        }
+        else if (_fps) {
+            animationPoll();
+        }
+        else if (_prevTime != t) {
+            stripUpdate(_prevTime = t);
+        }
+    }
+
+    // millis() of next poll() with work to do: effect step, animation frame,
+    // second boundary or brightness update
+    uint32_t nextDeadline() {
+        const uint32_t now = millis();
+#ifdef LED_OUTPUT_I2S
+        if (_strip.busy()) {
+            return now;
+        }
+#endif
+        uint32_t deadline;
+        if (_effect.active()) {
+            deadline = _effect.nextStep();
+        }
+        else if (_fps && time(NULL) >= TIME_VALID_SINCE) {
+            deadline = _nextFrame;
+        }
+        else {
+            timeval tv;
+            gettimeofday(&tv, NULL);
+            deadline = now + 1000 - tv.tv_usec / 1000;
         }
+        if ((_auto.getMode() != BRIGHTNESS_MANUAL || _level != _brightness) && (int32_t)(_nextLevel - deadline) < 0) {
+            deadline = _nextLevel;
+        }
+        return deadline;
     }
 
     void clear() {
         _strip.clear();
+        _invalid = true;
+    }
+
+    uint8_t getFace() {
+        return _face;
+    }
+
+    // select clock face, FACE_CLASSIC, FACE_STEPPED or FACE_ROUGH
+    static bool isValidFace(long face) {
+        return face >= 0 && face < FACE_COUNT;
+    }
+
+    bool setFace(uint8_t face) {
+        if (!isValidFace(face)) {
+            return false;
+        }
+        _face = face;
+        _prevTime = 0;
+        return true;
+    }
+
+    uint8_t getFps() {
+        return _fps;
+    }
+
+    // set animation frame rate, zero switches back to once per second updates
+    static bool isValidFps(long fps) {
+        return fps >= 0 && fps <= ANIMATION_FPS_MAX;
+    }
+
+    bool setFps(uint8_t fps) {
+        if (!isValidFps(fps)) {
+            return false;
+        }
+        if (fps != _fps) {
+            // last frame of previous mode stays on strip otherwise, static face is
+            // drawn again only when second changes
+            _prevTime = 0;
+            _invalid = true;
+        }
+        _fps = fps;
+        _frameInterval = fps ? 1000 / fps : 0;
+        _nextFrame = _statsStart = millis();
+        _statsFrames = _fpsAchieved = 0;
+        _dropped = 0;
+        return true;
+    }
+
+    // frames per second achieved in animation mode
+    uint16_t getAchievedFps() {
+        return _fps ? _fpsAchieved : 0;
+    }
+
+    uint32_t getDroppedFrames() {
+        return _dropped;
+    }
+
+    // last rendered frame, LED_COUNT pixels
+    const uint32_t* getFrame() {
+        return _frame;
+    }
+
+    // number of pixels changed by last frame, zero when strip update was skipped
+    uint16_t getChangedPixels() {
+        return _changed;
     }
 
     uint8_t getBrightness() {
-        return _strip.getBrightness();
+        return _brightness;
     }
     
+    // perceived brightness, strip is not scaled by NeoPixel but by gamma tables
     void setBrightness(uint8_t brightness) {
-        _strip.setBrightness(brightness);
+        _brightness = brightness;
+        _nextLevel = millis();
     }
 
-    bool setBrightnessAndColorScheme(String brightnessStr, String colorsStr) {
-        int brightness = brightnessStr.toInt();
-        if (brightness < 0x00 || brightness > 0xff) {
+    // brightness level currently applied, follows sensor or schedule in automatic modes
+    uint8_t getLevel() {
+        return _level;
+    }
+
+    // select brightness source, night level and ADC readings of dark and lit room
+    bool setAutoBrightness(uint8_t mode, uint8_t night, uint16_t dark, uint16_t bright) {
+        if (!_auto.configure(mode, night, dark, bright)) {
+            return false;
+        }
+        _nextLevel = millis();
+        return true;
+    }
+
+    AutoBrightness& getAutoBrightness() {
+        return _auto;
+    }
+
+    uint16_t getPowerBudget() {
+        return _powerBudget;
+    }
+
+    // budget must leave current for some light above idle draw of the strip
+    static bool isValidPowerBudget(long budget) {
+        return budget == 0 || (budget > estimateCurrent(0) && budget <= 0xFFFF);
+    }
+
+    // limit estimated strip current, mA, zero removes limit
+    bool setPowerBudget(uint16_t budget) {
+        if (!isValidPowerBudget(budget)) {
+            return false;
+        }
+        _powerBudget = budget;
+        frameUpdate();
+        return true;
+    }
+
+    // estimated current of last frame, mA
+    uint16_t getCurrent() {
+        return _current;
+    }
+
+    uint16_t getPeakCurrent() {
+        return _peakCurrent;
+    }
+
+    uint32_t getLimitedFrames() {
+        return _limitedFrames;
+    }
+
+    const Histogram& getRenderTime() {
+        return _renderTime;
+    }
+
+    const Histogram& getShowTime() {
+        return _showTime;
+    }
+
+    // parse decimal brightness and hex color scheme without applying them
+    static bool parseBrightnessAndColorScheme(const String& brightnessStr, const String& colorsStr,
+            uint8_t& brightness, uint32_t* colors) {
+        const long value = brightnessStr.toInt();
+        if (value < 0x00 || value > 0xff) {
             return false;
         }
 
         const char * str = colorsStr.c_str();
         const int len = sizeof(_colors) / sizeof(uint32_t);
-        uint32_t colors[len];
 
         if (colorsStr.length() != len * 6) {
             return false;
@@ -105,7 +440,16 @@ class ClockDisplay {
                 return false;
             }
         }
+        brightness = value;
+        return true;
+    }
 
+    bool setBrightnessAndColorScheme(String brightnessStr, String colorsStr) {
+        uint8_t brightness;
+        uint32_t colors[sizeof(_colors) / sizeof(uint32_t)];
+        if (!parseBrightnessAndColorScheme(brightnessStr, colorsStr, brightness, colors)) {
+            return false;
+        }
         setBrightnessAndColorScheme(brightness, colors);
         return true;
     }
@@ -126,13 +470,13 @@ class ClockDisplay {
 
     String getColorScheme2() {
         char buf[2 + 1 + 6 * 5 + 1];
-        sprintf(buf, "%02X:%06X%06X%06X%06X%06X", _strip.getBrightness(),
+        sprintf(buf, "%02X:%06X%06X%06X%06X%06X", _brightness,
             _colors[0], _colors[1], _colors[2], _colors[3], _colors[4]);
         return String(buf);
     }
 
     void setBrightnessAndColorScheme(uint8_t brightness, uint32_t* colors) {
-        _strip.setBrightness(brightness);
+        setBrightness(brightness);
         const int len = sizeof(_colors) / sizeof(uint32_t);
         for (int i = 0; i < len; i++)
             _colors[i] = colors[i];
@@ -140,99 +484,61 @@ class ClockDisplay {
 
 
     void copyBrightnessAndColorScheme(uint8_t* brightness, uint32_t* colors) {
-        brightness[0] = _strip.getBrightness();
+        brightness[0] = _brightness;
         const int len = sizeof(_colors) / sizeof(uint32_t);
         for (int i = 0; i < len; i++)
             colors[i] = _colors[i];
     }
 
     String getColorScheme() {
-        int len = sizeof(_colors) / sizeof(uint32_t);
-        char buf[len * 6 + 1];
+        char buf[COLOR_SCHEME_SIZE];
+        return String(getColorScheme(buf));
+    }
 
+    // Write color scheme hex string into buffer of COLOR_SCHEME_SIZE chars
+    char* getColorScheme(char* buf) {
+        int len = sizeof(_colors) / sizeof(uint32_t);
         for(int n = 0; n < len; n++) {
             sprintf(buf + n * 6, "%06x", _colors[n]);
         }
-
-        return String(buf);
+        return buf;
     }
 
     void stripUpdate(time_t time) {
-        tm* lct = localtime(&time);
-        uint8_t ss = lct->tm_sec, mm = lct->tm_min, hh = lct->tm_hour;
+        renderFace(LocalTime::at(time), 0, false);
+        frameUpdate();
+    }
 
-        for(uint8_t i = 0; i < LED_COUNT; i++) {
-            if (_colors[IDC_SECONDS] && (ss == i / LEDS_PER_MINUTE)) { // draw second marker
-                _strip.setPixelColor(i, _colors[IDC_SECONDS]);
-            }
-            else if (mm == i / LEDS_PER_MINUTE && (ss % 2 == 0)) { // draw minute marker (even seconds only)
-                _strip.setPixelColor(i, _colors[IDC_MINUTES]);
-            } 
-            else if (((i % LEDS_PER_HOUR) || (ss % 2)) &&  // draw hour marker (on tick leds odd seconds only)
-                    (12 - 1 + hh) % 12 == (LED_COUNT + i - 1 - mm * LEDS_PER_HOUR / 60) % LED_COUNT / LEDS_PER_HOUR) {
-                _strip.setPixelColor(i, (hh < 6 || hh > 17)
-                    ? _colors[IDC_HOURS_N]
-                    : _colors[IDC_HOURS_D]);
-            }
-            else if (i % LEDS_PER_HOUR) { // damp non-tick space
-                _strip.setPixelColor(i, 0x000000);
-            }
-            else _strip.setPixelColor(i, _colors[IDC_TICKS]); // draw ticks
-        }
-        _strip.show();
-    }
-
-    // // hours indication smooth steps
-    // void stripUpdate__(unsigned long time) {
-    //     uint8_t ss = time % 60;
-    //     uint8_t hh = time / 3600;
-    //     uint8_t mm = time / 60 - hh * 60; 
-    //     for(uint8_t i = 0; i < LED_COUNT; i++) {
-    //         if (_colors[IDC_SECONDS] && (ss == i / LEDS_PER_MINUTE)) {
-    //             _strip.setPixelColor(i, _colors[IDC_SECONDS]);
-    //         }
-    //         else if (mm == i / LEDS_PER_MINUTE) {
-    //             _strip.setPixelColor(i, _colors[IDC_MINUTES]);
-    //         }
-    //         else if (i % LEDS_PER_HOUR) {
-    //             if ((11 + hh) % 12 == (LED_COUNT + i - 1 - mm * LEDS_PER_HOUR / 60) % LED_COUNT / LEDS_PER_HOUR) {
-    //                 _strip.setPixelColor(i, (hh < 6 || hh > 17)
-    //                     ? _colors[IDC_HOURS_N]
-    //                     : _colors[IDC_HOURS_D]);
-    //             }
-    //             else _strip.setPixelColor(i, 0x000000);
-    //         }
-    //         else {
-    //             _strip.setPixelColor(i, _colors[IDC_TICKS]);
-    //         }
-    //     }
-    //     _strip.show();
-    // }
+    // send changed pixels of rendered frame to strip, skip show() when frame is unchanged,
+    // frame is scaled by brightness and then down to power budget
+    uint16_t frameUpdate() {
+        uint32_t pixels[LED_COUNT];
+        uint32_t channels = 0;
+        for (uint16_t i = 0; i < LED_COUNT; i++) {
+            channels += channelSum(pixels[i] = scaleColor(_frame[i]));
+        }
+        if (_powerBudget && estimateCurrent(channels) > _powerBudget) {
+            channels = powerLimit(pixels, channels);
+            _limitedFrames++;
+        }
+        _current = estimateCurrent(channels);
+        if (_current > _peakCurrent) {
+            _peakCurrent = _current;
+        }
 
-    // // hours indication rough steps after hour changes
-    // void stripUpdate_(unsigned long time) {
-    //     uint8_t ss = time % 60;
-    //     uint8_t hh = time / 3600;
-    //     uint8_t mm = time / 60 - hh * 60; 
-    //     for(uint8_t i = 0; i < LED_COUNT; i++) {
-    //         if (_colors[IDC_SECONDS] && (ss == i / LEDS_PER_MINUTE)) {
-    //             _strip.setPixelColor(i, _colors[IDC_SECONDS]);
-    //         }
-    //         else if (mm == i / LEDS_PER_MINUTE) {
-    //             _strip.setPixelColor(i, _colors[IDC_MINUTES]);
-    //         }
-    //         else if (i % LEDS_PER_HOUR) {
-    //             if ((hh % 12) == (i / LEDS_PER_HOUR)) {
-    //                 _strip.setPixelColor(i, (hh < 6 || hh > 17)
-    //                     ? _colors[IDC_HOURS_N]
-    //                     : _colors[IDC_HOURS_D]);
-    //             }
-    //             else _strip.setPixelColor(i, 0x000000);
-    //         }
-    //         else {
-    //             _strip.setPixelColor(i, _colors[IDC_TICKS]);
-    //         }
-    //     }
-    //     _strip.show();
-    // }
+        uint16_t changed = 0;
+        for (uint16_t i = 0; i < LED_COUNT; i++) {
+            if (_invalid || pixels[i] != _shown[i]) {
+                _strip.setPixelColor(i, _shown[i] = pixels[i]);
+                changed++;
+            }
+        }
+        if (changed) {
+            const uint32_t start = micros();
+            _strip.show();
+            _showTime.record(micros() - start);
+        }
+        _invalid = false;
+        return _changed = changed;
+    }
 };
\ No newline at end of file
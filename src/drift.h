@@ -0,0 +1,190 @@
+#pragma once
+
+#include <Arduino.h>
+#include <sys/time.h>
+#include "checksum.h"
+#include "mytime.h"
+
+extern "C" {
+#include <user_interface.h>
+}
+
+#define DRIFT_RTC_MAGIC 0x44524654      // "DRFT"
+#define DRIFT_RTC_OFFSET 32             // RTC user memory block, first 128 bytes hold eboot OTA command
+#define DRIFT_RESTORE_MAX_MS 60000      // longer RTC timer gaps mean it was reset with the chip
+#define DRIFT_APPLY_MS 1000
+#define DRIFT_MIN_SPAN_S 7200           // NTP noise of few ms gives ppm errors over shorter spans
+#define DRIFT_MAX_SPAN_S 604800         // learning restarts weekly to follow aging and seasons
+#define DRIFT_STEP_US 500000LL          // larger NTP corrections restart learning
+#define DRIFT_MAX_PPB 200000
+#define DRIFT_STORE_DELTA_PPB 100       // smaller estimate changes are not written to flash
+#define DRIFT_STORE_INTERVAL_MS 21600000UL
+
+// Learns frequency error of local oscillator from NTP corrections and applies it
+// to system clock continuously, so time stays within a second per week while
+// network is down. Error is the sum of all adjustments (own compensation and NTP
+// corrections) over raw micros64() time since first synchronization of span.
+// Current time is kept in RTC user memory, soft reset restores it right away.
+class DriftCompensation {
+    private:
+    struct RtcRecord {
+        uint32_t magic;
+        uint32_t seconds;
+        uint32_t micros;
+        uint32_t rtc;           // system_get_rtc_time() when saved
+        int32_t drift;
+        uint32_t crc;
+    };
+
+    int32_t _drift;             // ppb, positive when local oscillator runs slow
+    bool _enabled;
+    bool _restored;
+    uint64_t _lastApply;        // micros64()
+    int64_t _remainder;         // compensation not applied yet, 10^-9 us
+    uint64_t _anchor;           // micros64() of first synchronization of span, 0 when learning restarts
+    int64_t _adjusted;          // us added to clock since anchor
+    int32_t _stored;            // estimate last written to configuration
+    uint32_t _lastStore;
+    bool _everStored;
+
+    static int64_t nowMicros() {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+
+    static bool setMicros(int64_t us) {
+        timeval tv = { (time_t)(us / 1000000), (suseconds_t)(us % 1000000) };
+        return settimeofday(&tv, NULL) == 0;
+    }
+
+    static uint32_t crc(const RtcRecord& record) {
+        return Checksum::crc32((const uint8_t*)&record, offsetof(RtcRecord, crc));
+    }
+
+    bool restore() {
+        RtcRecord record;
+        if (!ESP.rtcUserMemoryRead(DRIFT_RTC_OFFSET, (uint32_t*)&record, sizeof(record)) ||
+                record.magic != DRIFT_RTC_MAGIC || record.crc != crc(record)) {
+            return false;
+        }
+        // RTC timer keeps counting over software and watchdog resets, time since
+        // boot is the lower bound when it was reset too
+        uint64_t elapsed = (uint64_t)(system_get_rtc_time() - record.rtc) * system_rtc_clock_cali_proc() >> 12;
+        if (elapsed > DRIFT_RESTORE_MAX_MS * 1000ULL) {
+            elapsed = micros64();
+        }
+        const int64_t us = (int64_t)record.seconds * 1000000 + record.micros + elapsed;
+        return setMicros(us + (int64_t)record.drift * (int64_t)elapsed / 1000000000);
+    }
+
+    public:
+    DriftCompensation() : _drift(0), _enabled(false), _restored(false), _lastApply(0), _remainder(0),
+        _anchor(0), _adjusted(0), _stored(0), _lastStore(0), _everStored(false) {
+    }
+
+    // start with stored estimate, restores time kept in RTC memory before reset
+    bool begin(int32_t drift) {
+        _drift = constrain(drift, -DRIFT_MAX_PPB, DRIFT_MAX_PPB);
+        _stored = _drift;
+        _enabled = true;
+        _lastApply = micros64();
+        _restored = time(NULL) < TIME_VALID_SINCE && restore();
+        if (_restored) {
+            Serial.println("Time restored from RTC memory");
+        }
+        return _restored;
+    }
+
+    // beacon followers learn drift against leader instead
+    void setEnabled(bool enabled) {
+        _enabled = enabled;
+        _remainder = 0;
+        restart();
+    }
+
+    // time was set by hand, corrections since anchor say nothing about oscillator
+    void restart() {
+        _anchor = 0;
+        _adjusted = 0;
+    }
+
+    // NTP correction just made, excluding offset still slewed from previous one,
+    // returns true when new estimate should be stored. Stepped clock starts new span.
+    bool sample(int64_t correction, bool stepped = false) {
+        if (!_enabled) {
+            return false;
+        }
+        const uint64_t now = micros64();
+        if (!_anchor || stepped || correction > DRIFT_STEP_US || correction < -DRIFT_STEP_US) {
+            _anchor = now;
+            _adjusted = 0;
+            return false;
+        }
+        _adjusted += correction;
+        const uint64_t span = now - _anchor;
+        if (span < DRIFT_MIN_SPAN_S * 1000000ULL) {
+            return false;
+        }
+        const int64_t estimate = _adjusted * 1000000000LL / (int64_t)span;
+        _drift = constrain(estimate, -DRIFT_MAX_PPB, DRIFT_MAX_PPB);
+        if (span >= DRIFT_MAX_SPAN_S * 1000000ULL) {
+            _anchor = now;
+            _adjusted = 0;
+        }
+
+        const int32_t change = _drift - _stored;
+        if ((change >= DRIFT_STORE_DELTA_PPB || change <= -DRIFT_STORE_DELTA_PPB) &&
+                (!_everStored || millis() - _lastStore >= DRIFT_STORE_INTERVAL_MS)) {
+            _stored = _drift;
+            _lastStore = millis();
+            _everStored = true;
+            return true;
+        }
+        return false;
+    }
+
+    // poll from loop(), applies compensation and keeps time in RTC memory once per second
+    void poll() {
+        const uint64_t now = micros64();
+        if (now - _lastApply < DRIFT_APPLY_MS * 1000ULL) {
+            return;
+        }
+        if (_enabled && time(NULL) >= TIME_VALID_SINCE) {
+            _remainder += (int64_t)_drift * (int64_t)(now - _lastApply);
+            const int64_t us = _remainder / 1000000000;
+            if (us && setMicros(nowMicros() + us)) {
+                _remainder -= us * 1000000000;
+                _adjusted += _anchor ? us : 0;
+            }
+        }
+        _lastApply = now;
+
+        if (time(NULL) >= TIME_VALID_SINCE) {
+            const int64_t us = nowMicros();
+            RtcRecord record = { DRIFT_RTC_MAGIC, (uint32_t)(us / 1000000), (uint32_t)(us % 1000000),
+                system_get_rtc_time(), _drift, 0 };
+            record.crc = crc(record);
+            ESP.rtcUserMemoryWrite(DRIFT_RTC_OFFSET, (uint32_t*)&record, sizeof(record));
+        }
+    }
+
+    uint32_t nextDeadline() const {
+        const int64_t remaining = (int64_t)(_lastApply + DRIFT_APPLY_MS * 1000ULL - micros64());
+        return millis() + (remaining > 0 ? remaining / 1000 : 0);
+    }
+
+    // oscillator frequency error, ppb
+    int32_t getDrift() const {
+        return _drift;
+    }
+
+    // seconds of current learning span
+    uint32_t getSpan() const {
+        return _anchor ? (micros64() - _anchor) / 1000000 : 0;
+    }
+
+    bool isRestored() const {
+        return _restored;
+    }
+};
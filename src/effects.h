@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include "clockface.h"
+
+#define EFFECT_NONE 0x00
+#define EFFECT_TEST 0x01    // red, green, blue and white fill, one second each
+#define EFFECT_BOOT 0x02    // comet sweeping one revolution around the ring
+
+#define EFFECT_TEST_STEP_MS 1000
+#define EFFECT_BOOT_MS      1200
+#define EFFECT_BOOT_TAIL    6
+
+// Cooperative display effects, each effect is a sequence of timed steps rendered
+// into frame on poll instead of blocking with delay()
+class DisplayEffect {
+    private:
+    uint8_t _effect;
+    uint8_t _next;
+    uint16_t _step;
+    uint32_t _stepStart;
+
+    uint16_t stepCount() const {
+        switch (_effect) {
+            case EFFECT_TEST: return 4;
+            case EFFECT_BOOT: return LED_COUNT + EFFECT_BOOT_TAIL;
+            default: return 0;
+        }
+    }
+
+    uint32_t stepDuration() const {
+        switch (_effect) {
+            case EFFECT_TEST: return EFFECT_TEST_STEP_MS;
+            case EFFECT_BOOT: return EFFECT_BOOT_MS / LED_COUNT;
+            default: return 0;
+        }
+    }
+
+    void renderTest(uint32_t* frame) const {
+        static const uint32_t colors[] = { 0xFF0000, 0x00FF00, 0x0000FF, 0xFFFFFF };
+        for (uint16_t i = 0; i < LED_COUNT; i++) {
+            frame[i] = colors[_step];
+        }
+    }
+
+    void renderBoot(uint32_t* frame, const uint32_t* colors) const {
+        for (uint16_t i = 0; i < LED_COUNT; i++) {
+            frame[i] = 0x000000;
+        }
+        for (uint16_t n = 0; n < EFFECT_BOOT_TAIL; n++) {
+            if (_step >= n && _step - n < LED_COUNT) {
+                frame[_step - n] = ClockFace::blend(0x000000, colors[IDC_HOURS_D],
+                    255 - n * 255 / EFFECT_BOOT_TAIL);
+            }
+        }
+    }
+
+    public:
+    DisplayEffect() : _effect(EFFECT_NONE), _next(EFFECT_NONE), _step(0), _stepStart(0) {
+    }
+
+    // start effect, optional next effect follows it when finished
+    void start(uint8_t effect, uint32_t now, uint8_t next = EFFECT_NONE) {
+        _effect = effect;
+        _next = next;
+        _step = 0;
+        _stepStart = now;
+    }
+
+    void stop() {
+        _effect = EFFECT_NONE;
+        _next = EFFECT_NONE;
+    }
+
+    bool active() const {
+        return _effect != EFFECT_NONE;
+    }
+
+    // millis() of next step change
+    uint32_t nextStep() const {
+        return _stepStart + stepDuration();
+    }
+
+    // advance effect to time now and render current step, returns false when effect is finished
+    bool render(uint32_t* frame, const uint32_t* colors, uint32_t now) {
+        while (_effect && now - _stepStart >= stepDuration()) {
+            _stepStart += stepDuration();
+            if (++_step >= stepCount()) {
+                _effect = _next;
+                _next = EFFECT_NONE;
+                _step = 0;
+            }
+        }
+
+        switch (_effect) {
+            case EFFECT_TEST: renderTest(frame); return true;
+            case EFFECT_BOOT: renderBoot(frame, colors); return true;
+            default: return false;
+        }
+    }
+};
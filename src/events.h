@@ -0,0 +1,170 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "jsonwriter.h"
+#include "configuration.h"
+#include "webserver.h"
+
+#define EVENT_CLIENTS_MAX 12
+#define EVENT_DATA_MAX 1152     // largest event data, status snapshot of 34 fields is 1084 bytes at worst
+#define EVENT_FRAMING_MAX 32    // "event: <name>\ndata: " and "\n\n", names up to 16 chars
+#define EVENT_SIZE_MAX (EVENT_DATA_MAX + EVENT_FRAMING_MAX)
+#define EVENT_KEEPALIVE_MS 15000
+#define EVENT_RETRY_MS 3000     // reconnect delay announced by async keep alive
+#define EVENT_MISSED_MAX 5      // drop subscriber after this many events not fitting its send buffer
+
+// Server-Sent Events stream, subscribers keep their HTTP connection open and get
+// events pushed from loop(). New subscriber gets "status" event with snapshot first,
+// snapshot returns zero when it did not fit and subscriber is refused then.
+// Writes never wait for network: event is skipped for subscriber whose TCP send
+// buffer is full and slow subscribers are disconnected.
+class EventStream {
+    public:
+    typedef size_t (*Snapshot)(char* buf, size_t size);
+
+    private:
+    uint32_t _lastSent;
+#ifdef ASYNC_WEBSERVER
+    AsyncEventSource* _source;
+#else
+    WiFiClient _clients[EVENT_CLIENTS_MAX];
+    uint8_t _missed[EVENT_CLIENTS_MAX];
+
+    void send(uint8_t i, const char* data, size_t len) {
+        if (_clients[i].availableForWrite() >= len && _clients[i].write((const uint8_t*)data, len) == len) {
+            _missed[i] = 0;
+        }
+        else if (++_missed[i] >= EVENT_MISSED_MAX) {
+            _clients[i].stop();
+        }
+    }
+
+    // take over web server client connection as event subscriber, writes response
+    // headers and returns subscriber index or -1 when all slots are taken
+    int8_t subscribe(WiFiClient client) {
+        for (uint8_t i = 0; i < EVENT_CLIENTS_MAX; i++) {
+            if (!_clients[i].connected()) {
+                client.setNoDelay(true);
+                client.print("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                    "Cache-Control: no-cache\r\nConnection: keep-alive\r\nAccess-Control-Allow-Origin: *\r\n\r\n");
+                _clients[i] = client;
+                _missed[i] = 0;
+                return i;
+            }
+        }
+        return -1;
+    }
+#endif
+
+    public:
+#ifdef ASYNC_WEBSERVER
+    EventStream() : _lastSent(0), _source(nullptr) {
+    }
+
+    void begin(HttpServer& server, const char* uri, Snapshot snapshot) {
+        _source = new AsyncEventSource(uri);
+        _source->onConnect([snapshot](AsyncEventSourceClient* client) {
+            char json[EVENT_DATA_MAX];
+            if (!snapshot(json, sizeof(json))) {
+                Serial.println("Event snapshot too long, subscriber dropped");
+                client->close();
+                return;
+            }
+            client->send(json, "status");
+        });
+        server.backend().addHandler(_source);
+    }
+
+    uint8_t subscribers() {
+        return _source ? _source->count() : 0;
+    }
+
+    // send event to all subscribers, AsyncEventSource queues and drops per client
+    void publish(const char* event, const char* data) {
+        if (_source) {
+            _source->send(data, event);
+        }
+        _lastSent = millis();
+    }
+
+    // AsyncEventSource cannot send comments, keep alive is "retry:" field without
+    // data, which clients take as reconnect delay and dispatch no event for
+    void poll() {
+        if (_source && millis() - _lastSent >= EVENT_KEEPALIVE_MS) {
+            _source->send(nullptr, nullptr, 0, EVENT_RETRY_MS);
+            _lastSent = millis();
+        }
+    }
+#else
+    EventStream() : _lastSent(0), _missed() {
+    }
+
+    void begin(HttpServer& server, const char* uri, Snapshot snapshot) {
+        server.on(uri, HTTP_GET, [this, snapshot](HttpRequest& request) {
+            char json[EVENT_DATA_MAX];
+            if (!snapshot(json, sizeof(json))) {
+                request.send(500, "text/plain", "Event snapshot too long");
+                return;
+            }
+            int8_t client = subscribe(request.client());
+            if (client < 0) {
+                request.send(503, "text/plain", "Too many event subscribers");
+                return;
+            }
+            publish("status", json, client);
+            Serial.println("Event subscriber connected");
+        });
+    }
+
+    uint8_t subscribers() {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < EVENT_CLIENTS_MAX; i++) {
+            if (_clients[i].connected()) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    // send event to all subscribers, or to single one by index
+    void publish(const char* event, const char* data, int8_t client = -1) {
+        static char buf[EVENT_SIZE_MAX];    // called from loop() only, keeps it off the stack
+        BufferWriter msg(buf, sizeof(buf));
+        msg.write("event: ").write(event).write("\ndata: ").write(data).write("\n\n");
+        if (msg.overflow()) {
+            Serial.printf("Event '%s' too long\n", event);
+            return;
+        }
+
+        for (uint8_t i = 0; i < EVENT_CLIENTS_MAX; i++) {
+            if ((client < 0 || client == i) && _clients[i].connected()) {
+                send(i, msg.c_str(), msg.length());
+            }
+        }
+        _lastSent = millis();
+    }
+
+    // send keep alive comment when stream was idle, call from loop()
+    void poll() {
+        if (millis() - _lastSent >= EVENT_KEEPALIVE_MS) {
+            for (uint8_t i = 0; i < EVENT_CLIENTS_MAX; i++) {
+                if (_clients[i].connected()) {
+                    send(i, ":\n\n", 3);
+                }
+            }
+            _lastSent = millis();
+        }
+    }
+#endif
+
+    // publish event only when its data differs from previously published one,
+    // prevCrc keeps CRC of last published data of this event
+    void publishChanged(const char* event, const char* data, uint16_t& prevCrc) {
+        const uint16_t crc = Configuration::crc16((const uint8_t*)data, strlen(data));
+        if (crc != prevCrc) {
+            prevCrc = crc;
+            publish(event, data);
+        }
+    }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Arduino.h>
+#include <i2s.h>
+#include "ws2812.h"
+
+#define I2S_STRIP_RESET_SAMPLES 32  // 320 us low level latches frame (WS2812B needs > 280 us)
+
+// WS2812 strip driven by I2S DMA on GPIO3 (RX pin), show() only encodes frame and
+// returns, poll() hands samples to DMA ring so interrupts are never disabled.
+// Frame is encoded into one of two buffers, next frame is rendered while previous
+// one is transmitted, pending frame is replaced by newer one when strip lags behind.
+// begin() muxes GPIO3 to I2S data out, Serial can no longer receive afterwards.
+class I2sStrip {
+    private:
+    uint16_t _count;
+    uint32_t* _pixels;
+    uint32_t* _buffers[2];
+    uint8_t _sending;           // buffer being transmitted
+    bool _pending;              // other buffer holds frame waiting for transmission
+    uint16_t _sent;             // samples of transmitted frame handed to DMA, including reset
+
+    uint16_t frameSamples() {
+        return _count * WS2812_SAMPLES_PER_PIXEL;
+    }
+
+    public:
+    I2sStrip(uint16_t count) : _count(count), _sending(0), _pending(false), _sent(0) {
+        _pixels = new uint32_t[count]();
+        _buffers[0] = new uint32_t[count * WS2812_SAMPLES_PER_PIXEL];
+        _buffers[1] = new uint32_t[count * WS2812_SAMPLES_PER_PIXEL];
+        _sent = frameSamples() + I2S_STRIP_RESET_SAMPLES;
+    }
+
+    void begin() {
+        i2s_rxtx_begin(false, true);
+        i2s_set_dividers(WS2812_I2S_DIV1, WS2812_I2S_DIV2);
+    }
+
+    void setPixelColor(uint16_t n, uint32_t color) {
+        if (n < _count) {
+            _pixels[n] = color;
+        }
+    }
+
+    void clear() {
+        memset(_pixels, 0, _count * sizeof(uint32_t));
+    }
+
+    // encode frame into free buffer, transmission continues from poll()
+    void show() {
+        const uint8_t free = _sent < frameSamples() + I2S_STRIP_RESET_SAMPLES ? 1 - _sending : _sending;
+        Ws2812Encoder::encode(_pixels, _count, _buffers[free]);
+        if (free == _sending) {
+            _sent = 0;
+        }
+        else _pending = true;
+        poll();
+    }
+
+    // frame or latch samples are still waiting for DMA ring
+    bool busy() {
+        return _pending || _sent < frameSamples() + I2S_STRIP_RESET_SAMPLES;
+    }
+
+    // feed DMA ring without blocking, underflow outputs low level (core mutes free buffers)
+    void poll() {
+        const uint16_t total = frameSamples() + I2S_STRIP_RESET_SAMPLES;
+        while (true) {
+            if (_sent >= total) {
+                if (!_pending) {
+                    return;
+                }
+                _sending = 1 - _sending;
+                _pending = false;
+                _sent = 0;
+            }
+            const uint32_t sample = _sent < frameSamples() ? _buffers[_sending][_sent] : 0;
+            if (!i2s_write_sample_nb(sample)) {
+                return;
+            }
+            _sent++;
+        }
+    }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Writes text into fixed caller provided buffer without heap allocations,
+// output is always zero terminated and truncated on overflow
+class BufferWriter {
+    private:
+    char* _buf;
+    size_t _size;
+    size_t _len;
+    bool _overflow;
+
+    public:
+    BufferWriter(char* buf, size_t size) : _buf(buf), _size(size), _len(0), _overflow(false) {
+        _buf[0] = 0;
+    }
+
+    BufferWriter& write(char c) {
+        if (_len + 1 < _size) {
+            _buf[_len++] = c;
+            _buf[_len] = 0;
+        }
+        else _overflow = true;
+        return *this;
+    }
+
+    BufferWriter& write(const char* str) {
+        while (*str) {
+            write(*str++);
+        }
+        return *this;
+    }
+
+    BufferWriter& printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(_buf + _len, _size - _len, format, args);
+        va_end(args);
+        if (n < 0 || _len + n >= _size) {
+            _len = _size - 1;
+            _overflow = true;
+        }
+        else _len += n;
+        return *this;
+    }
+
+    const char* c_str() const {
+        return _buf;
+    }
+
+    size_t length() const {
+        return _len;
+    }
+
+    bool overflow() const {
+        return _overflow;
+    }
+};
+
+// Streams flat JSON object into fixed buffer: {"name":value, ...}
+class JsonWriter : public BufferWriter {
+    private:
+    bool _empty;
+
+    JsonWriter& name(const char* name) {
+        write(_empty ? '{' : ',');
+        _empty = false;
+        string(name).write(':');
+        return *this;
+    }
+
+    JsonWriter& string(const char* str) {
+        write('"');
+        for (; *str; str++) {
+            if (*str == '"' || *str == '\\') {
+                write('\\').write(*str);
+            }
+            else if ((uint8_t)*str < 0x20) {
+                printf("\\u%04x", (uint8_t)*str);
+            }
+            else write(*str);
+        }
+        write('"');
+        return *this;
+    }
+
+    public:
+    JsonWriter(char* buf, size_t size) : BufferWriter(buf, size), _empty(true) {
+    }
+
+    JsonWriter& add(const char* key, const char* value) {
+        return name(key).string(value);
+    }
+
+    JsonWriter& add(const char* key, long value) {
+        name(key).printf("%ld", value);
+        return *this;
+    }
+
+    JsonWriter& add(const char* key, long long value) {
+        name(key).printf("%lld", value);
+        return *this;
+    }
+
+    JsonWriter& add(const char* key, bool value) {
+        name(key).write(value ? "true" : "false");
+        return *this;
+    }
+
+    // close object, returns false when output did not fit into buffer
+    bool end() {
+        write(_empty ? "{}" : "}");
+        return !overflow();
+    }
+};
@@ -1,19 +1,41 @@
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
-#include <ESP8266WebServer.h>
 #include <ESP8266NetBIOS.h>
 #include <FS.h>
 #include <LittleFS.h>
+#include <WiFiUdp.h>
 #include <time.h>
+#include <inttypes.h>
 
 #include "configuration.h"
 #include "mytime.h"
+#include "ntp.h"
 #include "display.h"
+#include "jsonwriter.h"
+#include "webserver.h"
+#include "events.h"
+#include "webassets.h"
+#include "scheduler.h"
+#include "control.h"
+#include "beacon.h"
+#include "drift.h"
+#ifdef CLOCK_BENCHMARK
+#include "benchmark.h"
+#endif
 
 Configuration state;
 ClockDisplay display;
 wl_status_t wl_status = WL_IDLE_STATUS;
-ESP8266WebServer server(80);
+HttpServer server(80);
+WiFiUDP ntpUdp;
+Ntp ntp(ntpUdp);
+WiFiUDP controlUdp;
+ControlServer control(controlUdp);
+TimeBeacon beacon;
+DriftCompensation drift;
+EventStream events;
+WebAssets webAssets;
+IdleScheduler scheduler;
 
 inline bool net_status_good(wl_status_t status) {
     return status == WL_CONNECTED || status == WL_DISCONNECTED;
@@ -27,9 +49,261 @@ bool net_initialize() {
 }
 
 void initializeNTP() {
-    NtpHelper::initializeNTP(state.timezone, state.daylight,
-        state.timeServer1, state.timeServer2, state.timeServer3, state.ntpenabled);
+    NtpHelper::initializeTimezone(state.timezone);
+#ifdef CONTROL_KEY
+    if (!beacon.begin(state.beaconRole, CONTROL_KEY)) {
+        Serial.println("Time beacon start failed");
+    }
+#endif
+    // follower clock is disciplined by leader beacons only
+    ntp.begin(state.timeServer1, state.timeServer2, state.timeServer3,
+        state.ntpenabled && beacon.getRole() != BEACON_FOLLOWER);
+    drift.setEnabled(beacon.getRole() != BEACON_FOLLOWER);
+    LocalTime::invalidate();
+}
+
+// status is also the snapshot event of /events, one size for both
+#define STATUS_JSON_SIZE EVENT_DATA_MAX
+
+// Serialize live configuration, display and NTP state into buffer, returns JSON length
+// or zero when it did not fit
+size_t statusJson(char* buf, size_t size) {
+    char date[TIME_STRING_SIZE], colors[COLOR_SCHEME_SIZE];
+    Time::now().toString(date);
+    display.getColorScheme(colors);
+
+    JsonWriter json(buf, size);
+    json.add("date", date)
+        .add("timezone", state.timezone)
+        .add("ntpenabled", state.ntpenabled != 0)
+        .add("ntpsynced", ntp.isSyncronized())
+        .add("ntpoffset", (long long)ntp.getLastOffset())
+        .add("ntpdelay", (long)ntp.getLastDelay())
+        .add("ntpserver1", state.timeServer1)
+        .add("ntpserver2", state.timeServer2)
+        .add("ntpserver3", state.timeServer3)
+        .add("beaconrole", (long)state.beaconRole)
+        .add("beaconlocked", beacon.isLocked())
+        .add("beaconphase", (long)beacon.getPhase())
+        .add("beacondrift", (long)beacon.getDrift())
+        .add("clockdrift", (long)drift.getDrift())
+        .add("driftspan", (long)drift.getSpan())
+        .add("timerestored", drift.isRestored())
+        .add("brightness", (long)display.getBrightness())
+        .add("brightnessmode", (long)display.getAutoBrightness().getMode())
+        .add("nightbrightness", (long)display.getAutoBrightness().getNight())
+        .add("sensordark", (long)display.getAutoBrightness().getDark())
+        .add("sensorbright", (long)display.getAutoBrightness().getBright())
+        .add("ambient", (long)display.getAutoBrightness().getAmbient())
+        .add("level", (long)display.getLevel())
+        .add("powerbudget", (long)display.getPowerBudget())
+        .add("current", (long)display.getCurrent())
+        .add("currentpeak", (long)display.getPeakCurrent())
+        .add("limitedframes", (long)display.getLimitedFrames())
+        .add("dutycycle", (long)scheduler.getDutyCycle())
+        .add("wakeups", (long)scheduler.getWakeups())
+        .add("colors", colors)
+        .add("face", (long)display.getFace())
+        .add("fps", (long)display.getFps())
+        .add("fpsachieved", (long)display.getAchievedFps())
+        .add("dropped", (long)display.getDroppedFrames());
+    if (!json.end()) {
+        Serial.println("Status JSON truncated");
+        return 0;
+    }
+    return json.length();
+}
+
+// Prometheus text exposition of runtime telemetry, written in parts of chunked
+// response: histograms one per part, then heap and other gauges
+bool metricsPart(uint16_t part, BufferWriter& out) {
+    const uint8_t routes = server.routeCount();
+    if (part == 0) {
+        Histogram::header(out, "clock_loop_seconds", "histogram", "Busy time of loop() iteration");
+        scheduler.getLoopTime().write(out, "clock_loop_seconds");
+    }
+    else if (part == 1) {
+        Histogram::header(out, "clock_render_seconds", "histogram", "Clock face rendering time");
+        display.getRenderTime().write(out, "clock_render_seconds");
+    }
+    else if (part == 2) {
+        Histogram::header(out, "clock_show_seconds", "histogram", "Strip output time");
+        display.getShowTime().write(out, "clock_show_seconds");
+    }
+    else if (part == 3) {
+        Histogram::header(out, "clock_http_handler_seconds", "histogram", "Route handler time");
+    }
+    else if (part < 4 + routes) {
+        const HttpServer::Route& route = server.route(part - 4);
+        if (route.latency.count()) {
+            char labels[64];
+            snprintf(labels, sizeof(labels), "route=\"%s\",method=\"%s\"", route.uri, route.method);
+            route.latency.write(out, "clock_http_handler_seconds", labels);
+        }
+    }
+    else if (part == 4 + routes) {
+        Histogram::header(out, "clock_heap_free_bytes", "gauge", "Free heap");
+        out.printf("clock_heap_free_bytes %" PRIu32 "\n", ESP.getFreeHeap());
+        Histogram::header(out, "clock_heap_free_min_bytes", "gauge", "Lowest free heap sampled once per second");
+        out.printf("clock_heap_free_min_bytes %" PRIu32 "\n", scheduler.getHeapMin());
+        Histogram::header(out, "clock_heap_max_block_bytes", "gauge", "Largest free heap block");
+        out.printf("clock_heap_max_block_bytes %" PRIu32 "\n", ESP.getMaxFreeBlockSize());
+        Histogram::header(out, "clock_heap_fragmentation_percent", "gauge", "Heap fragmentation");
+        out.printf("clock_heap_fragmentation_percent %u\n", ESP.getHeapFragmentation());
+        Histogram::header(out, "clock_heap_fragmentation_max_percent", "gauge", "Highest heap fragmentation sampled once per second");
+        out.printf("clock_heap_fragmentation_max_percent %u\n", scheduler.getFragmentationMax());
+        Histogram::header(out, "clock_duty_cycle_ratio", "gauge", "Share of time spent outside idle sleep");
+        out.printf("clock_duty_cycle_ratio %u.%03u\n", scheduler.getDutyCycle() / 1000, scheduler.getDutyCycle() % 1000);
+        Histogram::header(out, "clock_frames_dropped_total", "counter", "Animation frames dropped");
+        out.printf("clock_frames_dropped_total %" PRIu32 "\n", display.getDroppedFrames());
+        Histogram::header(out, "clock_uptime_seconds", "counter", "Time since boot");
+        out.printf("clock_uptime_seconds %lu\n", millis() / 1000);
+    }
+    else return false;
+    return true;
+}
+
+// push time, synchronization and display state deltas to event subscribers once per second
+void publishEvents() {
+    static time_t prevTime;
+    static uint16_t prevSync, prevDisplay;
+
+    events.poll();
+    time_t t = time(NULL);
+    if (t == prevTime || !events.subscribers()) {
+        return;
+    }
+    prevTime = t;
+
+    char buf[STATUS_JSON_SIZE];
+    events.publish("time", Time(t).toString(buf));
+
+    JsonWriter sync(buf, sizeof(buf));
+    if (sync.add("ntpsynced", ntp.isSyncronized())
+        .add("ntpoffset", (long long)ntp.getLastOffset())
+        .add("ntpdelay", (long)ntp.getLastDelay())
+        .add("beaconlocked", beacon.isLocked())
+        .add("beaconphase", (long)beacon.getPhase())
+        .end()) {
+        events.publishChanged("sync", buf, prevSync);
+    }
+
+    char colors[COLOR_SCHEME_SIZE];
+    JsonWriter disp(buf, sizeof(buf));
+    if (disp.add("brightness", (long)display.getBrightness())
+        .add("colors", display.getColorScheme(colors))
+        .add("face", (long)display.getFace())
+        .add("fps", (long)display.getFps())
+        .add("brightnessmode", (long)display.getAutoBrightness().getMode())
+        .add("nightbrightness", (long)display.getAutoBrightness().getNight())
+        .end()) {
+        events.publishChanged("display", buf, prevDisplay);
+    }
+}
+
+// feed NTP corrections to drift learning, clock steps start new span, estimate is
+// stored when it moved enough
+void learnDrift() {
+    static uint32_t prevSync;
+    const uint32_t syncs = ntp.getSyncCount();
+    if (syncs == prevSync) {
+        return;
+    }
+    prevSync = syncs;
+    if (syncs && drift.sample(ntp.getLastCorrection(), ntp.wasStepped())) {
+        Serial.printf("Clock drift %" PRId32 " ppb\n", drift.getDrift());
+        if (!state.saveClockDrift(drift.getDrift())) {
+            Serial.println("Clock drift save failed");
+        }
+    }
+}
+
+// save configuration to journaled store, repeated calls without changes do not write flash
+void writeConfig(HttpRequest& request) {
+    bool unchanged = false;
+    bool succ = state.saveToStore(&unchanged);
+    const char* msg = !succ ? "Configuration save failed" :
+        unchanged ? "Configuration unchanged" : "Configuration saved";
+    request.send(succ ? 200 : 400, "text/html", msg);
+    Serial.println(msg);
+}
+
+// apply command of authenticated control packet, same effect as matching HTTP route
+bool controlCommand(const ControlCommand& command, ControlWriter& reply) {
+    AutoBrightness& automatic = display.getAutoBrightness();
+    switch (command.op) {
+        case CONTROL_SET_SCHEME: {
+            uint32_t colors[5];
+            for (uint8_t i = 0; i < 5; i++) {
+                colors[i] = command.rgb(1 + i * 3);
+            }
+            display.setBrightnessAndColorScheme(command.u8(0), colors);
+            display.copyBrightnessAndColorScheme(&state.displayBrightness, state.displayColors);
+            return true;
+        }
+        case CONTROL_SET_TIME: {
+            const timeval tv = { (time_t)command.u32(0), (suseconds_t)command.u32(4) };
+            if (tv.tv_usec >= 1000000 || settimeofday(&tv, NULL) != 0) {
+                return false;
+            }
+            drift.restart();
+            return true;
+        }
+        case CONTROL_SET_BRIGHTNESS:
+            if (command.length == 7 && !display.setAutoBrightness(
+                    command.u8(1), command.u8(2), command.u16(3), command.u16(5))) {
+                return false;
+            }
+            display.setBrightness(command.u8(0));
+            state.displayBrightness = display.getBrightness();
+            state.brightnessMode = automatic.getMode();
+            state.nightBrightness = automatic.getNight();
+            state.sensorDark = automatic.getDark();
+            state.sensorBright = automatic.getBright();
+            return true;
+        case CONTROL_COMMIT:
+            return state.saveToStore();
+        case CONTROL_QUERY: {
+            timeval tv;
+            gettimeofday(&tv, NULL);
+            reply.command(CONTROL_STATE, 39)
+                .u32(tv.tv_sec).u32(tv.tv_usec)
+                .u8(display.getBrightness()).u8(display.getLevel()).u8(automatic.getMode())
+                .u8(display.getFace()).u8(display.getFps())
+                .u8(ntp.isSyncronized() | ntp.isEnabled() << 1);
+            for (uint8_t i = 0; i < 5; i++) {
+                reply.rgb(state.displayColors[i]);
+            }
+            reply.u16(display.getCurrent()).u32(millis() / 1000).u32(ConfigStore::instance().sequence());
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef CLOCK_BENCHMARK
+void benchmark() {
+    Serial.printf("\nBenchmark (%u iterations)\n", BENCHMARK_ITERATIONS);
+    const time_t origin = time(NULL);
+    Benchmark::run("stripUpdate", [origin](uint16_t i) { display.stripUpdate(origin + i); });
+    Benchmark::run("getColorScheme", [](uint16_t) { display.getColorScheme(); });
+    Benchmark::run("statusJson", [](uint16_t) { char buf[STATUS_JSON_SIZE]; Benchmark::keep(statusJson(buf, sizeof(buf))); });
+    Benchmark::run("crc16", [](uint16_t) { Benchmark::keep(state.calculateChecksum()); });
+
+    static uint8_t blob[1024];
+    const uint32_t bitwise = Benchmark::run("crc16 bitwise 1K", [](uint16_t) { Benchmark::keep(Checksum::crc16Bitwise(blob, sizeof(blob))); });
+    const uint32_t table = Benchmark::run("crc16 table 1K", [](uint16_t) { Benchmark::keep(Checksum::crc16(blob, sizeof(blob))); });
+    const uint32_t slice4 = Benchmark::run("crc32 slice-by-4 1K", [](uint16_t) { Benchmark::keep(Checksum::crc32Slice4(blob, sizeof(blob))); });
+    // blob bytes per CPU cycle in thousandths, from nanoseconds per pass
+    auto throughput = [](uint32_t nanos) -> uint32_t {
+        return nanos ? sizeof(blob) * 1000000ULL / ((uint64_t)nanos * (F_CPU / 1000000)) : 0;
+    };
+    const uint32_t perCycle[] = { throughput(bitwise), throughput(table), throughput(slice4) };
+    Serial.printf("bytes per cycle: crc16 bitwise %" PRIu32 ".%03" PRIu32 ", table %" PRIu32 ".%03" PRIu32 ", crc32 slice-by-4 %" PRIu32 ".%03" PRIu32 "\n",
+        perCycle[0] / 1000, perCycle[0] % 1000, perCycle[1] / 1000, perCycle[1] % 1000, perCycle[2] / 1000, perCycle[2] % 1000);
+    Serial.println();
 }
+#endif
 
 void setup() {
     //pinMode(LED_BUILTIN, OUTPUT);
@@ -48,9 +322,20 @@ void setup() {
     // Serial.println(state.timeServer3);
 
 
+    drift.begin(state.clockDrift);
     initializeNTP();
 
     display.initialize(state.displayBrightness, state.displayColors);
+    display.setFps(state.displayFps);
+    display.setFace(state.displayFace);
+    display.setAutoBrightness(state.brightnessMode, state.nightBrightness, state.sensorDark, state.sensorBright);
+    if (!display.setPowerBudget(state.powerBudget)) {
+        Serial.printf("Stored power budget %u mA is below idle current, using %u mA\n",
+            state.powerBudget, DEFAULT_POWER_BUDGET);
+        state.powerBudget = DEFAULT_POWER_BUDGET;
+        display.setPowerBudget(state.powerBudget);
+    }
+    display.setWaitColor(0x440000);
 
     Serial.print("Initializing network: ");
     Serial.println(net_initialize() ? "OK" : "FAILED");
@@ -73,111 +358,184 @@ void setup() {
     Serial.print("Initializing filesystem: ");
     Serial.println(LittleFS.begin() ? "OK" : "FAILED");
 
-    server.on("/time", HTTP_GET, []() {
-        server.send(200, "text/html", Time::now().toString());
+    server.on("/time", HTTP_GET, [](HttpRequest& request) {
+        request.send(200, "text/html", Time::now().toString());
     });
 
-    server.on("/status", HTTP_GET, []() {
-        String json("{\"date\":\"[DATE]\", \"timezone\":[ZONE], \"daylight\":[DAYL], \"ntpenabled\":[NTPE], \"ntpserver1\":\"[NTP1]\", \"ntpserver2\":\"[NTP2]\", \"ntpserver3\":\"[NTP3]\", \"brightness\":[BRIG], \"colors\":\"[CLRS]\"}");
-        json.replace("[DATE]", Time::now().toString());
-        json.replace("[ZONE]", "3");
-        json.replace("[DAYL]", "0");
-        json.replace("[NTPE]", "true");
-        json.replace("[NTP1]", "0.pool.ntp.org");
-        json.replace("[NTP2]", "1.pool.ntp.org");
-        json.replace("[NTP3]", "time.nist.gov");
-        json.replace("[BRIG]", String(display.getBrightness()));
-        json.replace("[CLRS]", display.getColorScheme());
-
-        server.send(200, "application/json", json);
+    server.on("/status", HTTP_GET, [](HttpRequest& request) {
+        char json[STATUS_JSON_SIZE];
+        size_t len = statusJson(json, sizeof(json));
+        if (!len) {
+            request.send(500, "text/plain", "Status too large");
+            return;
+        }
+        request.send(200, "application/json", json, len);
         Serial.println("Processed GET(/status)");
     });
 
-    server.on("/set-date", HTTP_POST, []() {
-        String date = server.arg("date");
+    events.begin(server, "/events", statusJson);
+
+    server.on("/metrics", HTTP_GET, [](HttpRequest& request) {
+        request.sendParts(200, "text/plain; version=0.0.4", metricsPart);
+    });
+
+    server.on("/set-date", HTTP_POST, [](HttpRequest& request) {
+        String date = request.arg("date");
         //time_t tt = parse_datetime(date.c_str());
         //bool succ = (tt >= 0) && set_datetime(tt);
         bool succ = Time(date.c_str()).setSystemTime();
+        if (succ) {
+            drift.restart();
+        }
         String msg = String(succ ? "Set new date: " : "Date set failed: ") + date;
-        server.send(succ ? 200 : 400, "text/html", msg);
+        request.send(succ ? 200 : 400, "text/html", msg);
         Serial.println(msg);
     });
 
-    server.on("/syncronize", HTTP_POST, []() {
+    server.on("/syncronize", HTTP_POST, [](HttpRequest& request) {
+        ntp.requestSync();
+        request.send(200, "text/html", "NTP synchronization requested");
+        Serial.println("NTP synchronization requested");
+    });
+
+    server.on("/set-ntp", HTTP_POST, [](HttpRequest& request) {
+        // only arguments present in request are changed
+        String timezone = request.hasArg("timezone") ? request.arg("timezone") : String(state.timezone);
+        if (timezone.length() >= sizeof(state.timezone) || !TimeZone::validate(timezone.c_str())) {
+            String msg = String("Invalid timezone rules: ") + timezone;
+            request.send(400, "text/html", msg);
+            Serial.println(msg);
+            return;
+        }
+
+        timezone.toCharArray(state.timezone, sizeof(state.timezone));
+        if (request.hasArg("ntpserver1")) {
+            request.arg("ntpserver1").toCharArray(state.timeServer1, sizeof(state.timeServer1));
+        }
+        if (request.hasArg("ntpserver2")) {
+            request.arg("ntpserver2").toCharArray(state.timeServer2, sizeof(state.timeServer2));
+        }
+        if (request.hasArg("ntpserver3")) {
+            request.arg("ntpserver3").toCharArray(state.timeServer3, sizeof(state.timeServer3));
+        }
+        if (request.hasArg("ntpenabled")) {
+            state.ntpenabled = request.arg("ntpenabled").toInt() != 0;
+        }
+        if (request.hasArg("beaconrole") && (unsigned)request.arg("beaconrole").toInt() <= BEACON_FOLLOWER) {
+            state.beaconRole = request.arg("beaconrole").toInt();
+        }
         initializeNTP();
-        server.send(200, "text/html", "SNTP restarted");
-        Serial.println("SNTP restarted");
+
+        const char* msg = "NTP settings updated";
+        request.send(200, "text/html", msg);
+        Serial.println(msg);
     });
 
-    server.on("/set-display", HTTP_POST, []() {
-        if (display.setBrightnessAndColorScheme(
-            server.arg("brightness"), server.arg("colors"))) {
+    server.on("/set-display", HTTP_POST, [](HttpRequest& request) {
+        AutoBrightness& automatic = display.getAutoBrightness();
+        // every argument is validated before any is applied, failed request changes nothing
+        uint8_t brightness;
+        uint32_t colors[5];
+        const long fps = request.hasArg("fps") ? request.arg("fps").toInt() : display.getFps();
+        const long face = request.hasArg("face") ? request.arg("face").toInt() : display.getFace();
+        const bool brightnessMode = request.hasArg("brightnessmode");
+        const long mode = request.arg("brightnessmode").toInt();
+        const long night = request.arg("nightbrightness").toInt();
+        const long dark = request.arg("sensordark").toInt();
+        const long bright = request.arg("sensorbright").toInt();
+        const long budget = request.hasArg("powerbudget") ?
+            request.arg("powerbudget").toInt() : display.getPowerBudget();
+        if (ClockDisplay::parseBrightnessAndColorScheme(
+                request.arg("brightness"), request.arg("colors"), brightness, colors) &&
+                ClockDisplay::isValidFps(fps) && ClockDisplay::isValidFace(face) &&
+                (!brightnessMode || AutoBrightness::isValid(mode, night, dark, bright)) &&
+                ClockDisplay::isValidPowerBudget(budget)) {
+
+            display.setBrightnessAndColorScheme(brightness, colors);
+            if (request.hasArg("fps")) {
+                display.setFps(fps);
+            }
+            if (request.hasArg("face")) {
+                display.setFace(face);
+            }
+            if (brightnessMode) {
+                display.setAutoBrightness(mode, night, dark, bright);
+            }
+            display.setPowerBudget(budget);
 
             display.copyBrightnessAndColorScheme(
                 &state.displayBrightness, state.displayColors);
+            state.displayFps = display.getFps();
+            state.displayFace = display.getFace();
+            state.brightnessMode = automatic.getMode();
+            state.nightBrightness = automatic.getNight();
+            state.sensorDark = automatic.getDark();
+            state.sensorBright = automatic.getBright();
+            state.powerBudget = display.getPowerBudget();
         
             const char* msg = "Display scheme updated";
-            server.send(200, "text/html", msg);
+            request.send(200, "text/html", msg);
             Serial.println(msg);
         }
         else {
             const char* msg = "Display scheme update failed";
-            server.send(400, "text/html", msg);
+            request.send(400, "text/html", msg);
             Serial.println(msg);
         }
     });
 
-    server.on("/set-conn", HTTP_POST, []() {
-        String ssid = server.arg("ssid");
-        String pass = server.arg("pass");
+    server.on("/set-conn", HTTP_POST, [](HttpRequest& request) {
+        String ssid = request.arg("ssid");
+        String pass = request.arg("pass");
         ssid.toCharArray(state.wifiSSID, 16);
         pass.toCharArray(state.wifiPassword, 16);
-        server.send(true ? 200 : 400, "text/html", "OK");
+        request.send(true ? 200 : 400, "text/html", "OK");
         Serial.println("Connection data changed");
     });
 
-    server.on("/write-config", HTTP_POST, []() {
-        bool succ = state.saveToEEPROM();
-        String msg = String("Configuration saved to EEPROM: ") + succ ? "OK" : "FAIL";
-        server.send(succ ? 200 : 400, "text/html", msg);
-        Serial.println(msg);
-    });
+    server.on("/write-config", HTTP_POST, writeConfig);
+    server.on("/write-config", HTTP_GET, writeConfig);
 
-    server.on("/write-config", HTTP_GET, []() {
-        bool succ = state.saveToEEPROM();
-        String msg = String("Configuration saved to EEPROM: ") + succ ? "OK" : "FAIL";
-        server.send(succ ? 200 : 400, "text/html", msg);
-        Serial.println(msg);
+    server.on("/sync", HTTP_GET, [](HttpRequest& request) {
+        ntp.requestSync();
+        request.send(200, "text/html", "NTP synchronization requested");
     });
 
-    server.on("/sync", HTTP_GET, []() {
-        initializeNTP();
-        server.send(200, "text/html", "SNTP restarted");
-    });
-
-    server.on("/test", HTTP_GET, []() {
-        server.send(200, "text/plain", "OK");
+    server.on("/test", HTTP_GET, [](HttpRequest& request) {
         display.test();
+        request.send(200, "text/plain", "OK");
     });
 
-    server.serveStatic("/", LittleFS, "/", "no-cache"/*"max-age=3600"*/); //86400
+    // web UI is precompressed by scripts/build_webui.py, styles and scripts have content
+    // hash in name and are cached for a year, pages are revalidated by ETag
+    Serial.print("Web UI assets: ");
+    Serial.println(webAssets.load(LittleFS) ? webAssets.count() : 0);
+    server.enableETag(webAssets);
+    server.serveStatic("/css/", LittleFS, "/css/", "max-age=31536000, immutable");
+    server.serveStatic("/js/", LittleFS, "/js/", "max-age=31536000, immutable");
+    server.serveStatic("/", LittleFS, "/", "no-cache");
     server.begin();
 
-    display.test();
+#ifdef CONTROL_KEY
+    // batched binary commands from fleet controller, see control.h
+    Serial.print("UDP control: ");
+    Serial.println(control.begin(CONTROL_KEY, controlCommand) ? "OK" : "FAILED");
+#endif
+
+    display.startEffect(EFFECT_TEST, EFFECT_BOOT);
+    scheduler.begin();
+
+#ifdef CLOCK_BENCHMARK
+    benchmark();
+#endif
 }
 
 void loop() {
-    time_t lct = time(NULL);
-    if (lct < 1000000000LL) {
-        if (lct % 2) {
-            display.draw(WiFi.isConnected() ? 0x000044 : 0x440000, 0x0B0800);
-        }
-        else display.draw(0x000000, 0x0B0800);
-    }
-    else display.poll();
+    display.poll();
 
     if (WiFi.status() != wl_status) {
         wl_status = WiFi.status();
+        display.setWaitColor(wl_status == WL_CONNECTED ? 0x000044 : 0x440000);
         if (wl_status == WL_CONNECTED) {
             Serial.print("Station connected, IP address: ");
             Serial.println(WiFi.localIP());
@@ -191,9 +549,20 @@ void loop() {
         }
     }
 
+    ntp.poll(wl_status == WL_CONNECTED);
+    control.poll(wl_status == WL_CONNECTED);
+    beacon.poll(wl_status == WL_CONNECTED);
+    drift.poll();
+    learnDrift();
+
     if (wl_status == WL_CONNECTED) {
-        server.handleClient();
+        server.poll();
+        publishEvents();
     }
 
-    delay(1);
+    scheduler.until(display.nextDeadline());
+    scheduler.until(ntp.nextDeadline());
+    scheduler.until(beacon.nextDeadline());
+    scheduler.until(drift.nextDeadline());
+    scheduler.sleep();
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "jsonwriter.h"
+
+#define HISTOGRAM_BUCKETS 14        // 32 us ... 131 ms and overflow bucket
+#define HISTOGRAM_FIRST_SHIFT 5     // upper bound of first bucket is 2^5 us
+
+// Fixed size log2 latency histogram, bucket i counts values up to 2^(i + 5) us,
+// last bucket counts everything above. Recording is a few instructions, no heap.
+class Histogram {
+    private:
+    uint32_t _buckets[HISTOGRAM_BUCKETS];
+    uint32_t _count;
+    uint64_t _sum;              // us
+
+    // write microseconds as seconds with six decimals
+    static void writeSeconds(BufferWriter& out, uint64_t us) {
+        out.printf("%lu.%06lu", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+    }
+
+    public:
+    Histogram() : _buckets(), _count(0), _sum(0) {
+    }
+
+    void record(uint32_t us) {
+        uint8_t bucket = 0;
+        if (us > (1UL << HISTOGRAM_FIRST_SHIFT)) {
+            bucket = 32 - __builtin_clz(us - 1) - HISTOGRAM_FIRST_SHIFT;
+            if (bucket >= HISTOGRAM_BUCKETS) {
+                bucket = HISTOGRAM_BUCKETS - 1;
+            }
+        }
+        _buckets[bucket]++;
+        _count++;
+        _sum += us;
+    }
+
+    uint32_t count() const {
+        return _count;
+    }
+
+    // Prometheus histogram samples in seconds with cumulative buckets, labels
+    // are inserted before le label ("route=\"/status\"" for example)
+    void write(BufferWriter& out, const char* name, const char* labels = nullptr) const {
+        const char* separator = labels ? "," : "";
+        labels = labels ? labels : "";
+        uint32_t cumulative = 0;
+        for (uint8_t i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+            cumulative += _buckets[i];
+            out.printf("%s_bucket{%s%sle=\"", name, labels, separator);
+            writeSeconds(out, 1UL << (i + HISTOGRAM_FIRST_SHIFT));
+            out.printf("\"} %" PRIu32 "\n", cumulative);
+        }
+        out.printf("%s_bucket{%s%sle=\"+Inf\"} %" PRIu32 "\n", name, labels, separator, _count);
+        out.printf("%s_sum%s%s%s ", name, *labels ? "{" : "", labels, *labels ? "}" : "");
+        writeSeconds(out, _sum);
+        out.printf("\n%s_count%s%s%s %" PRIu32 "\n", name, *labels ? "{" : "", labels, *labels ? "}" : "", _count);
+    }
+
+    // metric family header
+    static void header(BufferWriter& out, const char* name, const char* type, const char* help) {
+        out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    }
+};
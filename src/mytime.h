@@ -1,6 +1,7 @@
 #include <Arduino.h>
 #include <time.h>
 #include <sntp.h>
+#include "timezone.h"
 
 #pragma once
 
@@ -8,6 +9,7 @@
 
 extern int settimeofday(const struct timeval* tv, const struct timezone* tz);
 
+// Stock lwIP SNTP control and timezone setup, system clock itself is disciplined by Ntp client (ntp.h)
 class NtpHelper {
     public:
     
@@ -28,11 +30,17 @@ class NtpHelper {
         }
     }
 
-    static void initializeNTP(uint8_t timezone, uint8_t daylight, // TZ_Europe_Moscow (TZ.h)
-        const char* timeServer1, const char* timeServer2, const char* timeServer3, bool enable = true) {
-        configTime(timezone * 3600, daylight * 3600, timeServer1, timeServer2, timeServer3);
-        enableNTP(enable);
-    } 
+    // apply POSIX TZ rules string, e.g. TZ_Europe_Moscow (TZ.h), and keep stock SNTP stopped
+    static void initializeTimezone(const char* timezone) {
+        if (!TimeZone::current().set(timezone)) {
+            Serial.println("Invalid timezone rules, using UTC");
+            timezone = "UTC0";
+            TimeZone::current().set(timezone);
+        }
+        setenv("TZ", timezone, 1);
+        tzset();
+        enableNTP(false);
+    }
 };
 
 // bool set_datetime(time_t time) {
@@ -62,6 +70,65 @@ class NtpHelper {
 // }
 
 #define NOT_A_TIME -1
+#define TIME_STRING_SIZE 17
+#define TIME_VALID_SINCE 1000000000LL  // earlier system time means clock was never set
+
+// Local time decomposition cache shared by display, HTTP and logging. Time is
+// decomposed once with precomputed TimeZone offset and then advanced by seconds and minutes,
+// full decomposition is repeated at next offset change, on hour rollover, backward
+// steps and jumps of an hour or more
+class LocalTime {
+    private:
+    struct Cache {
+        time_t time;
+        time_t until;       // next change of local offset
+        tm details;
+        bool valid;
+    };
+
+    static Cache& cache() {
+        static Cache cache = {};
+        return cache;
+    }
+
+    public:
+    // force full decomposition on next access, call after timezone change; cache
+    // depends on its argument only, setting system time does not affect it
+    static void invalidate() {
+        cache().valid = false;
+    }
+
+    static const tm& at(time_t time) {
+        Cache& c = cache();
+        const time_t delta = time - c.time;
+        if (c.valid && delta >= 0 && delta < 3600 && time < c.until) {
+            const uint32_t sec = c.details.tm_sec + (uint32_t)delta;
+            if (sec < 60) {
+                c.details.tm_sec = sec;
+                c.time = time;
+                return c.details;
+            }
+            const uint32_t min = c.details.tm_min + sec / 60;
+            if (min < 60) {
+                c.details.tm_sec = sec % 60;
+                c.details.tm_min = min;
+                c.time = time;
+                return c.details;
+            }
+        }
+
+        TimeZone& zone = TimeZone::current();
+        zone.toLocal(time, c.details);
+        c.until = zone.nextTransition(time);
+        c.time = time;
+        c.valid = true;
+        return c.details;
+    }
+
+    static const tm& now() {
+        return at(::time(NULL));
+    }
+};
 
 class Time {
     time_t _ms;
@@ -100,16 +167,20 @@ class Time {
         return _ms;
     }
 
-    tm* toDetails() {
-        return localtime(&_ms);
+    const tm& toDetails() const {
+        return LocalTime::at(_ms);
     }
 
     // Return time ISO string "YYYYMMDDTHHMMSSZ"
     String toString() const {
-        struct tm *t = localtime(&_ms);
-        char v[17];
-        strftime(v, sizeof(v), "%Y%m%dT%H%M%SZ", t);
-        return String(v);
+        char v[TIME_STRING_SIZE];
+        return String(toString(v));
+    }
+
+    // Write time ISO string "YYYYMMDDTHHMMSSZ" into buffer of TIME_STRING_SIZE chars
+    char* toString(char* buf) const {
+        strftime(buf, TIME_STRING_SIZE, "%Y%m%dT%H%M%SZ", &LocalTime::at(_ms));
+        return buf;
     }
 
     bool setSystemTime() {
@@ -2,82 +2,336 @@
 
 #include "Arduino.h"
 #include <Udp.h>
+#include <ESP8266WiFi.h>
+#include <lwip/dns.h>
+#include <sys/time.h>
 
 #define SEVENZYYEARS 2208988800UL
 #define NTP_PACKET_SIZE 48
 #define NTP_DEFAULT_LOCAL_PORT 1337
+#define NTP_SERVER_PORT 123
+#define NTP_SERVER_COUNT 3
+#define NTP_TIMEOUT_MS 1500             // wait for responses after requests sent
+#define NTP_SYNC_INTERVAL_MS 600000UL   // between successful synchronizations
+#define NTP_RETRY_INTERVAL_MS 15000UL   // after failed synchronization
+#define NTP_RESOLVE_INTERVAL 144        // resolve server names again every N synchronizations
+#define NTP_STEP_THRESHOLD_US 500000LL  // larger offsets step the clock instead of slewing
+#define NTP_SLEW_PPM 500                // slew rate, microseconds per second
+#define NTP_NO_SAMPLE INT32_MAX
 
+extern int settimeofday(const struct timeval* tv, const struct timezone* tz);
+
+// Non-blocking SNTP client. Requests are sent to all configured servers at once,
+// responses are collected from poll() and the sample with the smallest round trip
+// delay is used. Clock offset and delay are calculated from fractional originate,
+// receive and transmit timestamps. Small offsets are slewed gradually so displayed
+// seconds never jump or repeat, large offsets (or first synchronization) step the clock.
+// Server names are resolved by asynchronous lwIP lookups, servers without address
+// are skipped until their answer arrives.
 class Ntp {
     private:
+    // pending name lookup of one server, callback argument
+    struct Lookup {
+        Ntp*      ntp;
+        uint8_t   index;
+        bool      pending;
+    };
+
     UDP*          _udp;
     bool          _udpSetup       = false;
+    bool          _enabled        = false;
 
-    const char*   _poolServerName = "pool.ntp.org";
-    IPAddress     _poolServerIP;
+    const char*   _serverNames[NTP_SERVER_COUNT];
+    IPAddress     _serverIPs[NTP_SERVER_COUNT];
+    bool          _resolved[NTP_SERVER_COUNT];
+    Lookup        _lookups[NTP_SERVER_COUNT];
     unsigned int  _port           = NTP_DEFAULT_LOCAL_PORT;
-    long          _timeOffset     = 0;
     byte          _packetBuffer[NTP_PACKET_SIZE];
 
-    unsigned long _timeOrigin = 0;      // Last known time, in s
-    unsigned long _lastUpdate = 0;      // Time since last update, in ms
+    bool          _waiting        = false;
+    uint32_t      _requestStart   = 0;      // millis() of requests sent
+    uint32_t      _nextRequest    = 0;      // millis() of next synchronization
+    uint32_t      _syncCount      = 0;      // successful synchronizations since begin()
+    int64_t       _origins[NTP_SERVER_COUNT]; // request transmit timestamps, us
+    uint8_t       _responses      = 0;
+    uint8_t       _requests       = 0;
 
-    public:
-    Ntp(UDP& udp, long timeOffset) {
-        _udp = &udp;
-        _timeOffset = timeOffset;
+    int64_t       _sampleOffset   = 0;      // best sample of current round, us
+    int32_t       _sampleDelay    = NTP_NO_SAMPLE;
+
+    int64_t       _slewRemaining  = 0;      // offset still to be applied, us
+    uint32_t      _lastSlew       = 0;      // millis() of last slew step
+
+    int64_t       _lastOffset     = 0;      // last applied sample, us
+    int64_t       _lastCorrection = 0;      // last sample minus offset still pending from previous one, us
+    bool          _lastStepped    = false;
+    int32_t       _lastDelay      = NTP_NO_SAMPLE;
+
+    static int64_t nowMicros() {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+
+    static bool setMicros(int64_t us) {
+        timeval tv = { (time_t)(us / 1000000), (suseconds_t)(us % 1000000) };
+        return settimeofday(&tv, NULL) == 0;
+    }
+
+    // NTP timestamp (seconds since 1900 and 2^-32 fraction) to Unix microseconds
+    static int64_t readTimestamp(const byte* p) {
+        uint32_t seconds = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        uint32_t fraction = (uint32_t)p[4] << 24 | (uint32_t)p[5] << 16 | (uint32_t)p[6] << 8 | p[7];
+        int64_t epoch = (int64_t)seconds - SEVENZYYEARS;
+        if (seconds < 0x80000000UL) {
+            epoch += 0x100000000LL; // era 1, after 2036
+        }
+        return epoch * 1000000 + (int64_t)(((uint64_t)fraction * 1000000 + 0x80000000UL) >> 32);
+    }
+
+    static void writeTimestamp(byte* p, int64_t us) {
+        uint32_t seconds = (uint32_t)(us / 1000000 + SEVENZYYEARS);
+        uint32_t fraction = (uint32_t)((((uint64_t)(us % 1000000)) << 32) / 1000000);
+        for (uint8_t i = 0; i < 4; i++) {
+            p[i] = seconds >> (24 - i * 8);
+            p[i + 4] = fraction >> (24 - i * 8);
+        }
+    }
+
+    // answer of lookup started by resolve(), runs in lwIP context
+    static void resolved(const char* name, const ip_addr_t* address, void* arg) {
+        Lookup* lookup = (Lookup*)arg;
+        Ntp* ntp = lookup->ntp;
+        const uint8_t i = lookup->index;
+        lookup->pending = false;
+        if (!ntp->_serverNames[i] || strcmp(name, ntp->_serverNames[i]) != 0) {
+            return; // server replaced by begin() meanwhile
+        }
+        if (!address) {
+            Serial.printf("NTP server %s not resolved\n", name);
+            return; // previous address, if any, stays in use
+        }
+        ntp->_serverIPs[i] = IPAddress(address);
+        ntp->_resolved[i] = true;
+        // round that found no server address waits for retry, first answer starts it now
+        if (!ntp->_waiting && !ntp->_requests) {
+            ntp->requestSync();
+        }
     }
 
-    bool update() {
+    // start name lookup, cached names and literal addresses are resolved at once
+    void resolve(uint8_t i) {
+        ip_addr_t address;
+        const err_t err = dns_gethostbyname(_serverNames[i], &address, resolved, &_lookups[i]);
+        if (err == ERR_OK) {
+            _serverIPs[i] = IPAddress(&address);
+            _resolved[i] = true;
+        }
+        else _lookups[i].pending = err == ERR_INPROGRESS;
+    }
+
+    void sendRequests() {
         if (!_udpSetup) {
-            _udp->begin(this->_port);
+            _udp->begin(_port);
             _udpSetup = true;
         }
-
-        while(_udp->parsePacket()) {
+        while (_udp->parsePacket()) {
             _udp->flush();
         }
 
-        memset(_packetBuffer, 0, NTP_PACKET_SIZE);
-        _packetBuffer[0] = 0b11100011;
-        _packetBuffer[1] = 0;
-        _packetBuffer[2] = 6;
-        _packetBuffer[3] = 0xEC;
-        _packetBuffer[12]  = 49;
-        _packetBuffer[13]  = 0x4E;
-        _packetBuffer[14]  = 49;
-        _packetBuffer[15]  = 52;
-
-        _udp->beginPacket(_poolServerName, 123);
-        _udp->write(_packetBuffer, NTP_PACKET_SIZE);
-        _udp->endPacket();
-
-        uint8_t timeout = 0;
-        while (true) {
-            if (timeout++ > 100) {
-                return false;
+        _requests = _responses = 0;
+        _sampleDelay = NTP_NO_SAMPLE;
+        for (uint8_t i = 0; i < NTP_SERVER_COUNT; i++) {
+            _origins[i] = 0;
+            if (!_serverNames[i] || !_serverNames[i][0]) {
+                continue;
             }
-            delay(10);
-            if (_udp->parsePacket() == NTP_PACKET_SIZE) {
-                break;
+            if (!_lookups[i].pending && (!_resolved[i] || (_syncCount && _syncCount % NTP_RESOLVE_INTERVAL == 0))) {
+                resolve(i);
             }
+            if (!_resolved[i]) {
+                continue;
+            }
+
+            memset(_packetBuffer, 0, NTP_PACKET_SIZE);
+            _packetBuffer[0] = 0b00100011; // LI 0, version 4, client mode
+            _origins[i] = nowMicros();
+            writeTimestamp(_packetBuffer + 40, _origins[i]);
+
+            _udp->beginPacket(_serverIPs[i], NTP_SERVER_PORT);
+            _udp->write(_packetBuffer, NTP_PACKET_SIZE);
+            if (_udp->endPacket()) {
+                _requests++;
+            }
+            else _origins[i] = 0;
         }
 
-        _lastUpdate = millis() - (10 * timeout);
-        _udp->read(_packetBuffer, NTP_PACKET_SIZE);
+        _waiting = _requests > 0;
+        _requestStart = millis();
+        if (!_waiting) {
+            _nextRequest = _requestStart + NTP_RETRY_INTERVAL_MS;
+        }
+    }
+
+    void receiveResponses() {
+        while (_udp->parsePacket() == NTP_PACKET_SIZE) {
+            const int64_t t4 = nowMicros();
+            _udp->read(_packetBuffer, NTP_PACKET_SIZE);
 
-        unsigned long hw = word(_packetBuffer[40], _packetBuffer[41]);
-        unsigned long lw = word(_packetBuffer[42], _packetBuffer[43]);
-        unsigned long secsSince1900 = hw << 16 | lw;
+            const uint8_t leap = _packetBuffer[0] >> 6, mode = _packetBuffer[0] & 0x07, stratum = _packetBuffer[1];
+            if (leap == 3 || mode != 4 || stratum == 0 || stratum > 15) {
+                continue; // unsynchronized server or kiss-o'-death
+            }
 
-        _timeOrigin = secsSince1900 - SEVENZYYEARS;
-        return true;
+            // response originate timestamp must echo one of our requests
+            const int64_t t1 = readTimestamp(_packetBuffer + 24);
+            for (uint8_t i = 0; i < NTP_SERVER_COUNT; i++) {
+                const int64_t echo = t1 - _origins[i]; // timestamp conversion may round by 1 us
+                if (_origins[i] && echo >= -1 && echo <= 1) {
+                    const int64_t t2 = readTimestamp(_packetBuffer + 32), t3 = readTimestamp(_packetBuffer + 40);
+                    const int64_t delay = (t4 - _origins[i]) - (t3 - t2);
+                    const int64_t offset = ((t2 - _origins[i]) + (t3 - t4)) / 2;
+                    if (delay >= 0 && delay < _sampleDelay) {
+                        _sampleDelay = delay;
+                        _sampleOffset = offset;
+                    }
+                    _origins[i] = 0;
+                    _responses++;
+                    break;
+                }
+            }
+        }
+
+        if (_responses >= _requests || millis() - _requestStart >= NTP_TIMEOUT_MS) {
+            _waiting = false;
+            if (_sampleDelay != NTP_NO_SAMPLE) {
+                apply(_sampleOffset, _sampleDelay);
+                _nextRequest = millis() + NTP_SYNC_INTERVAL_MS;
+            }
+            else _nextRequest = millis() + NTP_RETRY_INTERVAL_MS;
+        }
+    }
+
+    void apply(int64_t offset, int32_t delay) {
+        // unapplied part of previous slew is contained in new offset again
+        _lastCorrection = offset - _slewRemaining;
+        _lastStepped = !isSyncronized() || offset > NTP_STEP_THRESHOLD_US || offset < -NTP_STEP_THRESHOLD_US;
+        if (_lastStepped) {
+            setMicros(nowMicros() + offset);
+            _slewRemaining = 0;
+        }
+        else {
+            _slewRemaining = offset;
+            _lastSlew = millis();
+        }
+        _lastOffset = offset;
+        _lastDelay = delay;
+        _syncCount++;
+    }
+
+    // apply pending offset in steps no larger than NTP_SLEW_PPM once per second
+    void slew() {
+        if (_slewRemaining == 0 || millis() - _lastSlew < 1000) {
+            return;
+        }
+        _lastSlew = millis();
+        const int64_t step = _slewRemaining > NTP_SLEW_PPM ? NTP_SLEW_PPM
+            : _slewRemaining < -NTP_SLEW_PPM ? -NTP_SLEW_PPM : _slewRemaining;
+        if (setMicros(nowMicros() + step)) {
+            _slewRemaining -= step;
+        }
+    }
+
+    public:
+    Ntp(UDP& udp) {
+        _udp = &udp;
+        for (uint8_t i = 0; i < NTP_SERVER_COUNT; i++) {
+            _serverNames[i] = nullptr;
+            _resolved[i] = false;
+            _lookups[i] = { this, i, false };
+            _origins[i] = 0;
+        }
+    }
+
+    // configure servers, names must stay valid while client is used
+    void begin(const char* server1, const char* server2, const char* server3, bool enable = true) {
+        _serverNames[0] = server1;
+        _serverNames[1] = server2;
+        _serverNames[2] = server3;
+        for (uint8_t i = 0; i < NTP_SERVER_COUNT; i++) {
+            _resolved[i] = false;
+            _lookups[i].pending = false;    // answer for previous name is dropped
+        }
+        _enabled = enable;
+        _waiting = false;
+        _syncCount = 0;
+        requestSync();
+    }
+
+    bool isEnabled() const {
+        return _enabled;
+    }
+
+    // synchronize on next poll
+    void requestSync() {
+        _nextRequest = millis();
+    }
+
+    // poll from loop(), never blocks waiting for network
+    void poll(bool connected) {
+        if (_waiting) {
+            receiveResponses();
+        }
+        else if (_enabled && connected && (int32_t)(millis() - _nextRequest) >= 0) {
+            sendRequests();
+        }
+        slew();
+    }
+
+    // millis() when poll() has work next, replies are read right away for accurate timestamps
+    uint32_t nextDeadline() const {
+        const uint32_t now = millis();
+        if (_waiting) {
+            return now;
+        }
+        uint32_t deadline = _enabled ? _nextRequest : now + NTP_SYNC_INTERVAL_MS;
+        if (_slewRemaining && (int32_t)(_lastSlew + 1000 - deadline) < 0) {
+            deadline = _lastSlew + 1000;
+        }
+        return deadline;
     }
 
     bool isSyncronized() const {
-        return _lastUpdate > 0;
+        return _syncCount > 0;
+    }
+
+    // successful synchronizations since begin(), changes when new offset is applied
+    uint32_t getSyncCount() const {
+        return _syncCount;
+    }
+
+    // clock offset of last applied sample, us
+    int64_t getLastOffset() const {
+        return _lastOffset;
+    }
+
+    // correction added by last sample on top of offset still being slewed, us
+    int64_t getLastCorrection() const {
+        return _lastCorrection;
+    }
+
+    // last sample set clock at once instead of slewing it
+    bool wasStepped() const {
+        return _lastStepped;
+    }
+
+    // round trip delay of last applied sample, us
+    int32_t getLastDelay() const {
+        return _lastDelay;
     }
 
-    unsigned long getTime() const {
-        return _timeOffset + _timeOrigin +  (millis() - _lastUpdate) / 1000;
+    // offset still being slewed, us
+    int32_t getPendingOffset() const {
+        return (int32_t)_slewRemaining;
     }
-};
\ No newline at end of file
+};
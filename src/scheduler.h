@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "metrics.h"
+
+#ifndef IDLE_SLEEP_MODE
+#ifdef LED_OUTPUT_I2S
+#define IDLE_SLEEP_MODE WIFI_MODEM_SLEEP    // light sleep stops I2S DMA clock
+#else
+#define IDLE_SLEEP_MODE WIFI_LIGHT_SLEEP
+#endif
+#endif
+
+#ifdef ASYNC_WEBSERVER
+#define IDLE_MAX_SLEEP_MS 1000  // requests are served from network callbacks while sleeping
+#else
+#define IDLE_MAX_SLEEP_MS 50    // synchronous web server is polled, bounds response latency
+#endif
+
+// Idle scheduler for loop(): components report their next deadline, CPU is parked
+// in delay() until the earliest one so WiFi modem (or light) sleep can engage between
+// frames. Busy time and wakeups are measured over one second windows, loop iteration
+// time is recorded into histogram and heap is sampled once per window.
+class IdleScheduler {
+    private:
+    uint32_t _deadline;         // earliest requested wakeup, millis()
+    uint32_t _wakeTime;         // micros() of last wakeup
+    uint32_t _windowStart;      // statistics window start, micros()
+    uint32_t _busy;             // busy time in window, us
+    uint16_t _wakeups;          // wakeups in window
+    uint16_t _dutyCycle;        // busy share of last window, 1/1000
+    uint16_t _wakeupRate;       // wakeups per second in last window
+    uint32_t _heapMin;          // lowest sampled free heap, bytes
+    uint8_t _fragmentationMax;  // highest sampled heap fragmentation, %
+    Histogram _loopTime;        // busy time of loop() iterations
+
+    public:
+    IdleScheduler() : _deadline(0), _wakeTime(0), _windowStart(0), _busy(0), _wakeups(0), _dutyCycle(1000), _wakeupRate(0),
+            _heapMin(UINT32_MAX), _fragmentationMax(0) {
+    }
+
+    void begin() {
+        WiFi.setSleepMode(IDLE_SLEEP_MODE);
+        _wakeTime = _windowStart = micros();
+        _deadline = millis();
+    }
+
+    // request wakeup not later than deadline, millis()
+    void until(uint32_t deadline) {
+        if ((int32_t)(deadline - _deadline) < 0) {
+            _deadline = deadline;
+        }
+    }
+
+    // park CPU until earliest deadline or IDLE_MAX_SLEEP_MS, call at end of loop()
+    void sleep() {
+        const uint32_t now = micros();
+        _busy += now - _wakeTime;
+        _wakeups++;
+        _loopTime.record(now - _wakeTime);
+        if (now - _windowStart >= 1000000) {
+            sampleHeap();
+            const uint32_t window = now - _windowStart;
+            _dutyCycle = (uint64_t)_busy * 1000 / window;
+            _wakeupRate = (uint64_t)_wakeups * 1000000 / window;
+            _windowStart = now;
+            _busy = 0;
+            _wakeups = 0;
+        }
+
+        const int32_t wait = _deadline - millis();
+        if (wait > 0) {
+            delay(wait < IDLE_MAX_SLEEP_MS ? wait : IDLE_MAX_SLEEP_MS);
+        }
+        else yield();
+
+        _wakeTime = micros();
+        _deadline = millis() + IDLE_MAX_SLEEP_MS;
+    }
+
+    void sampleHeap() {
+        const uint32_t heap = ESP.getFreeHeap();
+        const uint8_t fragmentation = ESP.getHeapFragmentation();
+        if (heap < _heapMin) {
+            _heapMin = heap;
+        }
+        if (fragmentation > _fragmentationMax) {
+            _fragmentationMax = fragmentation;
+        }
+    }
+
+    uint32_t getHeapMin() {
+        return _heapMin;
+    }
+
+    uint8_t getFragmentationMax() {
+        return _fragmentationMax;
+    }
+
+    const Histogram& getLoopTime() {
+        return _loopTime;
+    }
+
+    // share of time spent outside sleep() in last second, 1/1000
+    uint16_t getDutyCycle() {
+        return _dutyCycle;
+    }
+
+    uint16_t getWakeups() {
+        return _wakeupRate;
+    }
+};
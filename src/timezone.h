@@ -0,0 +1,233 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TZ_STRING_SIZE 48
+#define TZ_DEFAULT "MSK-3"      // TZ_Europe_Moscow (TZ.h)
+#define TZ_TRANSITION_YEARS 4   // years of precomputed DST transitions
+#define SECONDS_PER_DAY 86400L
+
+// POSIX TZ rules ("STD offset [DST [offset] [,start[/time],end[/time]]]") with
+// DST transition instants precomputed for TZ_TRANSITION_YEARS, converting UTC to
+// local time is an offset lookup instead of re-evaluating rules on every call
+class TimeZone {
+    private:
+    struct Rule {
+        char kind;          // 'M' month.week.weekday, 'J' julian day without leap day, 'D' zero based day
+        uint8_t month;
+        uint8_t week;
+        uint8_t weekday;
+        uint16_t day;
+        int32_t time;       // local time of transition, seconds
+    };
+
+    struct Transition {
+        time_t at;          // UTC instant
+        int32_t offset;     // local offset from UTC in effect since instant, seconds east
+    };
+
+    int32_t _stdOffset;
+    int32_t _dstOffset;
+    bool _hasDst;
+    Rule _start;
+    Rule _end;
+    time_t _rangeStart;     // UTC instants covered by transitions table
+    time_t _rangeEnd;
+    int32_t _initialOffset; // offset in effect at _rangeStart
+    Transition _transitions[TZ_TRANSITION_YEARS * 2];
+
+    static bool parseName(const char*& p) {
+        if (*p == '<') {
+            while (*p && *p != '>') p++;
+            return *p++ == '>';
+        }
+        const char* begin = p;
+        while ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z')) p++;
+        return p - begin >= 3;
+    }
+
+    static bool parseNumber(const char*& p, int32_t& value, int32_t max) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        for (value = 0; *p >= '0' && *p <= '9'; p++) {
+            value = value * 10 + *p - '0';
+            if (value > max) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // [+|-]hh[:mm[:ss]] into seconds
+    static bool parseTime(const char*& p, int32_t& seconds, int32_t maxHours) {
+        int32_t sign = *p == '-' ? -1 : 1, h, m = 0, s = 0;
+        if (*p == '-' || *p == '+') p++;
+        if (!parseNumber(p, h, maxHours)) return false;
+        if (*p == ':' && !parseNumber(++p, m, 59)) return false;
+        if (*p == ':' && !parseNumber(++p, s, 59)) return false;
+        seconds = sign * (h * 3600 + m * 60 + s);
+        return true;
+    }
+
+    static bool parseRule(const char*& p, Rule& rule) {
+        int32_t a, b, c;
+        if (*p == 'M') {
+            if (!parseNumber(++p, a, 12) || a < 1 || *p++ != '.' ||
+                    !parseNumber(p, b, 5) || b < 1 || *p++ != '.' || !parseNumber(p, c, 6)) {
+                return false;
+            }
+            rule.kind = 'M'; rule.month = a; rule.week = b; rule.weekday = c;
+        }
+        else if (*p == 'J') {
+            if (!parseNumber(++p, a, 365) || a < 1) return false;
+            rule.kind = 'J'; rule.day = a;
+        }
+        else {
+            if (!parseNumber(p, a, 365)) return false;
+            rule.kind = 'D'; rule.day = a;
+        }
+        rule.time = 2 * 3600;
+        return *p != '/' || parseTime(++p, rule.time, 167);
+    }
+
+    static bool isLeap(int32_t year) {
+        return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    }
+
+    // days since 1970-01-01 for civil date
+    static int32_t daysFromCivil(int32_t year, int32_t month, int32_t day) {
+        year -= month <= 2;
+        const int32_t era = (year >= 0 ? year : year - 399) / 400;
+        const int32_t yoe = year - era * 400;
+        const int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+    }
+
+    // days since 1970-01-01 of rule date in year
+    static int32_t ruleDay(const Rule& rule, int32_t year) {
+        const int32_t jan1 = daysFromCivil(year, 1, 1);
+        if (rule.kind == 'J') {
+            return jan1 + rule.day - 1 + (isLeap(year) && rule.day >= 60);
+        }
+        if (rule.kind == 'D') {
+            return jan1 + rule.day;
+        }
+        const int32_t first = daysFromCivil(year, rule.month, 1);
+        const int32_t next = rule.month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, rule.month + 1, 1);
+        const int32_t weekday = ((first + 4) % 7 + 7) % 7; // 1970-01-01 was Thursday
+        int32_t day = first + (rule.weekday - weekday + 7) % 7 + (rule.week - 1) * 7;
+        while (day >= next) day -= 7;
+        return day;
+    }
+
+    // precompute transitions for TZ_TRANSITION_YEARS starting from year
+    void build(int32_t year) {
+        _rangeStart = (time_t)daysFromCivil(year, 1, 1) * SECONDS_PER_DAY;
+        _rangeEnd = (time_t)daysFromCivil(year + TZ_TRANSITION_YEARS, 1, 1) * SECONDS_PER_DAY;
+        if (!_hasDst) {
+            _initialOffset = _stdOffset;
+            return;
+        }
+
+        for (uint8_t i = 0; i < TZ_TRANSITION_YEARS; i++) {
+            Transition start = { (time_t)ruleDay(_start, year + i) * SECONDS_PER_DAY + _start.time - _stdOffset, _dstOffset };
+            Transition end = { (time_t)ruleDay(_end, year + i) * SECONDS_PER_DAY + _end.time - _dstOffset, _stdOffset };
+            const bool northern = start.at < end.at;
+            _transitions[i * 2] = northern ? start : end;
+            _transitions[i * 2 + 1] = northern ? end : start;
+        }
+        // southern hemisphere zones start the year in daylight time
+        _initialOffset = _transitions[0].offset == _dstOffset ? _stdOffset : _dstOffset;
+    }
+
+    public:
+    TimeZone() : _stdOffset(0), _dstOffset(0), _hasDst(false), _start(), _end(),
+            _rangeStart(0), _rangeEnd(0), _initialOffset(0), _transitions() {
+    }
+
+    static TimeZone& current() {
+        static TimeZone zone;
+        return zone;
+    }
+
+    static bool validate(const char* rules) {
+        TimeZone zone;
+        return zone.set(rules);
+    }
+
+    // parse POSIX TZ rules, keeps previous rules and returns false when invalid
+    bool set(const char* rules) {
+        TimeZone zone;
+        const char* p = rules;
+        if (!parseName(p) || !parseTime(p, zone._stdOffset, 24)) {
+            return false;
+        }
+        zone._stdOffset = -zone._stdOffset; // POSIX offsets are west of UTC
+        zone._dstOffset = zone._stdOffset;
+
+        if (*p) {
+            if (!parseName(p)) {
+                return false;
+            }
+            zone._hasDst = true;
+            zone._dstOffset = zone._stdOffset + 3600;
+            if (*p && *p != ',') {
+                if (!parseTime(p, zone._dstOffset, 24)) return false;
+                zone._dstOffset = -zone._dstOffset;
+            }
+            if (*p == ',') {
+                if (!parseRule(++p, zone._start) || *p++ != ',' || !parseRule(p, zone._end)) {
+                    return false;
+                }
+            }
+            else { // US rules by default
+                const char* defaults = "M3.2.0,M11.1.0";
+                parseRule(defaults, zone._start);
+                parseRule(++defaults, zone._end);
+            }
+        }
+        if (*p) {
+            return false;
+        }
+
+        *this = zone;
+        return true;
+    }
+
+    // local offset from UTC at instant, seconds east
+    int32_t offsetAt(time_t time) {
+        if (time < _rangeStart || time >= _rangeEnd) {
+            tm utc;
+            gmtime_r(&time, &utc);
+            build(utc.tm_year + 1900);
+        }
+
+        int32_t offset = _initialOffset;
+        for (uint8_t i = 0; _hasDst && i < TZ_TRANSITION_YEARS * 2 && _transitions[i].at <= time; i++) {
+            offset = _transitions[i].offset;
+        }
+        return offset;
+    }
+
+    // first instant after time when local offset may change, DST transition or
+    // end of precomputed range
+    time_t nextTransition(time_t time) {
+        offsetAt(time);
+        for (uint8_t i = 0; _hasDst && i < TZ_TRANSITION_YEARS * 2; i++) {
+            if (_transitions[i].at > time) {
+                return _transitions[i].at;
+            }
+        }
+        return _rangeEnd;
+    }
+
+    void toLocal(time_t time, tm& details) {
+        const int32_t offset = offsetAt(time);
+        const time_t local = time + offset;
+        gmtime_r(&local, &details);
+        details.tm_isdst = _hasDst && offset != _stdOffset;
+    }
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#define WEB_ASSETS_MAX 8
+#define WEB_ASSET_PATH_SIZE 40
+#define WEB_ASSET_ETAG_SIZE 16
+#define WEB_ASSETS_MANIFEST "/etags"
+
+// ETags of precompressed web UI files, loaded from manifest written by
+// scripts/build_webui.py ("<path> <etag>" per line)
+class WebAssets {
+    private:
+    struct Asset {
+        char path[WEB_ASSET_PATH_SIZE];
+        char etag[WEB_ASSET_ETAG_SIZE];
+    };
+
+    Asset _assets[WEB_ASSETS_MAX];
+    uint8_t _count;
+
+    public:
+    WebAssets() : _count(0) {
+    }
+
+    bool load(fs::FS& fs) {
+        File file = fs.open(WEB_ASSETS_MANIFEST, "r");
+        if (!file) {
+            return false;
+        }
+        for (_count = 0; _count < WEB_ASSETS_MAX && file.available(); ) {
+            String line = file.readStringUntil('\n');
+            Asset& asset = _assets[_count];
+            if (sscanf(line.c_str(), "%39s %15s", asset.path, asset.etag) == 2) {
+                _count++;
+            }
+        }
+        file.close();
+        return true;
+    }
+
+    // ETag of served file path, empty when file is not in manifest
+    const char* etag(const char* path) const {
+        for (uint8_t i = 0; i < _count; i++) {
+            if (strcmp(_assets[i].path, path) == 0) {
+                return _assets[i].etag;
+            }
+        }
+        return "";
+    }
+
+    uint8_t count() const {
+        return _count;
+    }
+};
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#ifdef ASYNC_WEBSERVER
+#include <ESPAsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+#else
+#include <ESP8266WebServer.h>
+#endif
+#include "webassets.h"
+#include "metrics.h"
+
+#define WEB_RESPONSE_SIZE 512
+#define WEB_RESPONSE_SLOTS 6    // async backend: responses in flight, each with own buffer
+#define WEB_ROUTES_MAX 16       // routes with latency histograms
+#define WEB_PART_SIZE 1536      // buffer of one part of chunked response
+
+#ifdef ASYNC_WEBSERVER
+typedef WebRequestMethodComposite WebMethod;
+#else
+typedef HTTPMethod WebMethod;
+#endif
+
+// Writes part of chunked response, returns false when there are no more parts
+typedef std::function<bool(uint16_t part, BufferWriter& out)> PartWriter;
+
+// Request passed to route handlers, same interface for blocking ESP8266WebServer
+// backend and event driven ESPAsyncWebServer backend (ASYNC_WEBSERVER build flag)
+class HttpRequest {
+    private:
+#ifdef ASYNC_WEBSERVER
+    AsyncWebServerRequest* _request;
+
+    struct ResponseSlot {
+        char data[WEB_RESPONSE_SIZE];
+        bool used;
+    };
+
+    // chunked response state, single response in flight
+    struct PartStream {
+        AsyncWebServerRequest* request;
+        PartWriter writer;
+        uint16_t part;
+        size_t length;
+        size_t sent;
+        bool busy;
+        char data[WEB_PART_SIZE];
+    };
+
+    static PartStream& partStream() {
+        static PartStream stream;
+        return stream;
+    }
+
+    // response buffers live until connection is closed, async send reads them later
+    static ResponseSlot* acquireSlot() {
+        static ResponseSlot slots[WEB_RESPONSE_SLOTS];
+        for (uint8_t i = 0; i < WEB_RESPONSE_SLOTS; i++) {
+            if (!slots[i].used) {
+                slots[i].used = true;
+                return &slots[i];
+            }
+        }
+        return nullptr;
+    }
+#else
+    ESP8266WebServer& _server;
+#endif
+
+    public:
+#ifdef ASYNC_WEBSERVER
+    HttpRequest(AsyncWebServerRequest* request) : _request(request) {
+    }
+
+    String arg(const char* name) {
+        return _request->arg(name);
+    }
+
+    bool hasArg(const char* name) {
+        return _request->hasArg(name);
+    }
+
+    void send(int code, const char* contentType, const char* content, size_t length) {
+        ResponseSlot* slot = length < WEB_RESPONSE_SIZE ? acquireSlot() : nullptr;
+        if (!slot) {
+            _request->send(503);
+            return;
+        }
+        memcpy(slot->data, content, length);
+        _request->onDisconnect([slot]() { slot->used = false; });
+        _request->send(_request->beginResponse_P(code, contentType, (const uint8_t*)slot->data, length));
+    }
+
+    // send response larger than any buffer in parts written on demand
+    void sendParts(int code, const char* contentType, PartWriter writer) {
+        PartStream& stream = partStream();
+        if (stream.busy) {
+            _request->send(503);
+            return;
+        }
+        // fields are reset in place, temporary of whole stream would land on small SYS stack
+        stream.request = _request;
+        stream.writer = writer;
+        stream.part = 0;
+        stream.length = 0;
+        stream.sent = 0;
+        stream.busy = true;
+        _request->onDisconnect([]() {
+            partStream().busy = false;
+            partStream().writer = nullptr;
+        });
+        AsyncWebServerResponse* response = _request->beginChunkedResponse(contentType,
+            [](uint8_t* buffer, size_t maxLen, size_t) -> size_t {
+                PartStream& stream = partStream();
+                while (stream.sent >= stream.length) {
+                    BufferWriter out(stream.data, sizeof(stream.data));
+                    if (!stream.writer || !stream.writer(stream.part++, out)) {
+                        return 0;
+                    }
+                    if (out.overflow()) {
+                        // closing without last chunk makes client see response as failed
+                        Serial.printf("Response part %u truncated, connection closed\n", stream.part - 1);
+                        stream.request->client()->close(true);
+                        return 0;
+                    }
+                    stream.length = out.length();
+                    stream.sent = 0;
+                }
+                const size_t n = stream.length - stream.sent < maxLen ? stream.length - stream.sent : maxLen;
+                memcpy(buffer, stream.data + stream.sent, n);
+                stream.sent += n;
+                return n;
+            });
+        response->setCode(code);
+        _request->send(response);
+    }
+#else
+    HttpRequest(ESP8266WebServer& server) : _server(server) {
+    }
+
+    String arg(const char* name) {
+        return _server.arg(name);
+    }
+
+    bool hasArg(const char* name) {
+        return _server.hasArg(name);
+    }
+
+    // connection of current request, to be taken over by long lived streams
+    WiFiClient& client() {
+        return _server.client();
+    }
+
+    void send(int code, const char* contentType, const char* content, size_t length) {
+        _server.send(code, contentType, content, length);
+    }
+
+    // send response larger than any buffer in parts written on demand
+    void sendParts(int code, const char* contentType, PartWriter writer) {
+        static char data[WEB_PART_SIZE];
+        _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        _server.send(code, contentType, "");
+        for (uint16_t part = 0; ; part++) {
+            BufferWriter out(data, sizeof(data));
+            if (!writer(part, out)) {
+                break;
+            }
+            if (out.overflow()) {
+                // headers are gone already, closing without last chunk makes client
+                // see response as failed instead of truncated
+                Serial.printf("Response part %u truncated, connection closed\n", part);
+                _server.client().stop();
+                return;
+            }
+            if (out.length()) {
+                _server.sendContent(data, out.length());
+            }
+        }
+        _server.sendContent("");
+    }
+#endif
+
+    void send(int code, const char* contentType, const char* content) {
+        send(code, contentType, content, strlen(content));
+    }
+
+    void send(int code, const char* contentType, const String& content) {
+        send(code, contentType, content.c_str(), content.length());
+    }
+};
+
+// HTTP server facade over selected backend, handler time of every route is
+// recorded into latency histogram
+class HttpServer {
+    public:
+    struct Route {
+        const char* uri;
+        const char* method;
+        Histogram latency;
+    };
+
+    private:
+#ifdef ASYNC_WEBSERVER
+    AsyncWebServer _server;
+#else
+    ESP8266WebServer _server;
+#endif
+    Route _routes[WEB_ROUTES_MAX];
+    uint8_t _routeCount;
+
+    public:
+    typedef std::function<void(HttpRequest&)> Handler;
+
+    HttpServer(uint16_t port) : _server(port), _routeCount(0) {
+    }
+
+    void on(const char* uri, WebMethod method, Handler handler) {
+        Route* route = nullptr;
+        if (_routeCount < WEB_ROUTES_MAX) {
+            route = &_routes[_routeCount++];
+            route->uri = uri;
+            route->method = method == HTTP_GET ? "GET" : method == HTTP_POST ? "POST" : "ANY";
+        }
+#ifdef ASYNC_WEBSERVER
+        _server.on(uri, method, [handler, route](AsyncWebServerRequest* request) {
+            const uint32_t start = micros();
+            HttpRequest req(request);
+            handler(req);
+            if (route) {
+                route->latency.record(micros() - start);
+            }
+        });
+#else
+        _server.on(uri, method, [this, handler, route]() {
+            const uint32_t start = micros();
+            HttpRequest req(_server);
+            handler(req);
+            if (route) {
+                route->latency.record(micros() - start);
+            }
+        });
+#endif
+    }
+
+    uint8_t routeCount() const {
+        return _routeCount;
+    }
+
+    const Route& route(uint8_t index) const {
+        return _routes[index];
+    }
+
+    void serveStatic(const char* uri, fs::FS& fs, const char* path, const char* cacheControl) {
+        _server.serveStatic(uri, fs, path, cacheControl);
+    }
+
+    // answer If-None-Match from precompressed assets manifest (blocking backend only,
+    // async backend serves the same gzip files without revalidation)
+    void enableETag(WebAssets& assets) {
+#ifndef ASYNC_WEBSERVER
+        _server.enableETag(true, [&assets](fs::FS&, const String& path) -> String {
+            return assets.etag(path.c_str());
+        });
+#else
+        static_cast<void>(assets);
+#endif
+    }
+
+    void begin() {
+        _server.begin();
+    }
+
+    // serve pending requests, async backend serves them from TCP callbacks instead
+    void poll() {
+#ifndef ASYNC_WEBSERVER
+        _server.handleClient();
+#endif
+    }
+
+    // underlying server of selected backend
+#ifdef ASYNC_WEBSERVER
+    AsyncWebServer& backend() {
+        return _server;
+    }
+#else
+    ESP8266WebServer& backend() {
+        return _server;
+    }
+#endif
+};
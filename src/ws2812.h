@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define WS2812_SAMPLES_PER_PIXEL 3  // one 32 bit sample per color byte
+#define WS2812_I2S_DIV1 10          // 160 MHz / (10 * 5) = 3.2 MHz bit clock,
+#define WS2812_I2S_DIV2 5           // four I2S bits per 1.25 us WS2812 bit
+
+// WS2812 bitstream encoder for serial (I2S) output, hardware independent so it can be
+// checked on host. Every WS2812 bit takes four output bits: 0 is 1000 (0.31 us high),
+// 1 is 1110 (0.94 us high), so one color byte fills one 32 bit sample.
+class Ws2812Encoder {
+    private:
+    // four data bits into 16 output bits, first data bit in most significant nibble
+    static uint16_t nibble(uint8_t bits) {
+        uint16_t result = 0;
+        for (uint8_t i = 0; i < 4; i++) {
+            result = (result << 4) | ((bits & (0x08 >> i)) ? 0x0E : 0x08);
+        }
+        return result;
+    }
+
+    public:
+    // sample for color byte, I2S shifts out lower half word first
+    static uint32_t sample(uint8_t value) {
+        return nibble(value >> 4) | (uint32_t)nibble(value & 0x0F) << 16;
+    }
+
+    // encode 0xRRGGBB pixels in GRB order expected by WS2812
+    static void encode(const uint32_t* pixels, size_t count, uint32_t* samples) {
+        for (size_t i = 0; i < count; i++) {
+            *samples++ = sample(pixels[i] >> 8);
+            *samples++ = sample(pixels[i] >> 16);
+            *samples++ = sample(pixels[i]);
+        }
+    }
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+
+// NeoPixel stand-in, keeps pixels and counts show() calls instead of driving GPIO
+class Adafruit_NeoPixel {
+    private:
+    uint16_t _count;
+    uint8_t _brightness;
+    std::vector<uint32_t> _pixels;
+    uint32_t _shows;
+
+    public:
+    Adafruit_NeoPixel(uint16_t count, int16_t, uint16_t)
+        : _count(count), _brightness(0), _pixels(count), _shows(0) {}
+
+    void begin() {}
+    void show() { _shows++; }
+    void clear() { std::fill(_pixels.begin(), _pixels.end(), 0); }
+    uint16_t numPixels() const { return _count; }
+    void setBrightness(uint8_t brightness) { _brightness = brightness; }
+    uint8_t getBrightness() const { return _brightness; }
+
+    void setPixelColor(uint16_t n, uint32_t color) {
+        if (n < _count) {
+            _pixels[n] = color & 0xFFFFFF;
+        }
+    }
+
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+        setPixelColor(n, Color(r, g, b));
+    }
+
+    uint32_t getPixelColor(uint16_t n) const {
+        return n < _count ? _pixels[n] : 0;
+    }
+
+    void fill(uint32_t color, uint16_t first, uint16_t count) {
+        for (uint16_t i = first; i < first + count && i < _count; i++) {
+            _pixels[i] = color;
+        }
+    }
+
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+        return (uint32_t)r << 16 | (uint32_t)g << 8 | b;
+    }
+
+    uint32_t shows() const { return _shows; }
+};
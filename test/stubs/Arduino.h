@@ -0,0 +1,247 @@
+#pragma once
+
+// Arduino core stand-in for host builds, just enough of ESP8266 core for the
+// hardware independent parts of firmware. Time, flash, RTC memory and network
+// are simulated by host.h.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/time.h>
+#include <string>
+#include <algorithm>
+#include "host.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define F_CPU 80000000L
+#define A0 17
+#define SPI_FLASH_SEC_SIZE 4096
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+using std::min;
+using std::max;
+
+// system clock of simulated node, libc clock of host is never touched
+inline int host_gettimeofday(struct timeval* tv, void*) {
+    const int64_t us = host::wallClock();
+    tv->tv_sec = us / 1000000;
+    tv->tv_usec = us % 1000000;
+    return 0;
+}
+
+inline int host_settimeofday(const struct timeval* tv, const struct timezone*) {
+    if (tv) {
+        host::setWallClock((int64_t)tv->tv_sec * 1000000 + tv->tv_usec);
+    }
+    return 0;
+}
+
+inline time_t host_time(time_t* t) {
+    const time_t now = host::wallClock() / 1000000;
+    if (t) {
+        *t = now;
+    }
+    return now;
+}
+
+#define gettimeofday(tv, tz) host_gettimeofday(tv, tz)
+#define settimeofday(tv, tz) host_settimeofday(tv, tz)
+#define time(t) host_time(t)
+
+inline unsigned long millis() {
+    return host::raw() / 1000;
+}
+
+inline unsigned long micros() {
+    return host::raw();
+}
+
+inline uint64_t micros64() {
+    return host::raw();
+}
+
+inline void delay(unsigned long ms) {
+    host::advance(ms * 1000);
+}
+
+inline void yield() {
+}
+
+inline int analogRead(uint8_t) {
+    return host::analog;
+}
+
+class String : public std::string {
+    public:
+    String() {}
+    String(const char* s) : std::string(s ? s : "") {}
+    String(const std::string& s) : std::string(s) {}
+    String(int value) : std::string(std::to_string(value)) {}
+    String(unsigned value) : std::string(std::to_string(value)) {}
+    String(long value) : std::string(std::to_string(value)) {}
+    String(unsigned long value) : std::string(std::to_string(value)) {}
+
+    long toInt() const {
+        return atol(c_str());
+    }
+
+    void toCharArray(char* buf, unsigned size) const {
+        strncpy(buf, c_str(), size);
+        if (size) {
+            buf[size - 1] = 0;
+        }
+    }
+
+    bool equals(const char* s) const {
+        return compare(s) == 0;
+    }
+
+    explicit operator bool() const {
+        return true;
+    }
+};
+
+class IPAddress;
+
+class Print {
+    public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) {
+        return host::verbose ? fputc(c, stdout) != EOF : 1;
+    }
+
+    virtual size_t write(const uint8_t* buf, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            write(buf[i]);
+        }
+        return size;
+    }
+
+    size_t write(const char* s) {
+        return write((const uint8_t*)s, strlen(s));
+    }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[512];
+        va_list args;
+        va_start(args, format);
+        const int len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        return len > 0 ? write((const uint8_t*)buf, strlen(buf)) : 0;
+    }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(const IPAddress& ip);
+    size_t println() { return write("\n"); }
+    template <typename T>
+    size_t println(const T& value) { return print(value) + println(); }
+};
+
+class HardwareSerial : public Print {
+    public:
+    void begin(unsigned long) {}
+};
+
+inline HardwareSerial Serial;
+
+struct ip_addr_t;
+
+class IPAddress {
+    private:
+    uint32_t _address;      // lwIP byte order
+
+    public:
+    IPAddress() : _address(0) {}
+    IPAddress(uint32_t address) : _address(address) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : _address(a | (uint32_t)b << 8 | (uint32_t)c << 16 | (uint32_t)d << 24) {}
+    IPAddress(const ip_addr_t* address) : _address(*(const uint32_t*)address) {}
+
+    operator uint32_t() const { return _address; }
+    operator const ip_addr_t*() const { return (const ip_addr_t*)&_address; }
+    bool operator==(const IPAddress& other) const { return _address == other._address; }
+    bool operator!=(const IPAddress& other) const { return _address != other._address; }
+    uint8_t operator[](int index) const { return _address >> (index * 8); }
+    bool isSet() const { return _address != 0; }
+
+    bool fromString(const char* s) {
+        unsigned a, b, c, d;
+        char end;
+        if (sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &end) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+            return false;
+        }
+        *this = IPAddress(a, b, c, d);
+        return true;
+    }
+
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return String(buf);
+    }
+};
+
+inline size_t Print::print(const IPAddress& ip) {
+    return print(ip.toString());
+}
+
+class EspClass {
+    public:
+    uint32_t getChipId() { return host::node().chipId; }
+    uint32_t getCycleCount() { return (uint32_t)(host::raw() * (F_CPU / 1000000)); }
+    uint32_t getFreeHeap() { return 40000; }
+    uint32_t getMaxFreeBlockSize() { return 30000; }
+    uint8_t getHeapFragmentation() { return 10; }
+    uint32_t random() { return host::random(); }
+    void wdtFeed() {}
+
+    bool flashEraseSector(uint32_t sector) {
+        return host::flash.erase(sector);
+    }
+
+    bool flashWrite(uint32_t address, const uint32_t* data, size_t size) {
+        return host::flash.write(address, (const uint8_t*)data, size);
+    }
+
+    bool flashRead(uint32_t address, uint32_t* data, size_t size) {
+        return host::flash.read(address, (uint8_t*)data, size);
+    }
+
+    // offset in 4 byte blocks, 512 bytes of user memory
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+        if (offset * 4 + size > sizeof(host::node().rtcMemory)) {
+            return false;
+        }
+        memcpy(data, (uint8_t*)host::node().rtcMemory + offset * 4, size);
+        return true;
+    }
+
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+        if (offset * 4 + size > sizeof(host::node().rtcMemory)) {
+            return false;
+        }
+        memcpy((uint8_t*)host::node().rtcMemory + offset * 4, data, size);
+        return true;
+    }
+};
+
+inline EspClass ESP;
+
+#define IPADDR4_INIT_BYTES(a, b, c, d) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+
+// EEPROM stand-in, emulated sector lives in RAM and starts erased
+class EEPROMClass {
+    private:
+    uint8_t _data[SPI_FLASH_SEC_SIZE];
+    size_t _size;
+
+    public:
+    EEPROMClass() : _size(0) {
+        memset(_data, 0xFF, sizeof(_data));
+    }
+
+    void begin(size_t size) { _size = size; }
+    bool end() { _size = 0; return true; }
+    bool commit() { return true; }
+    const uint8_t* getConstDataPtr() const { return _data; }
+    uint8_t* getDataPtr() { return _data; }
+
+    template <typename T>
+    T& get(int address, T& value) {
+        memcpy(&value, _data + address, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    const T& put(int address, const T& value) {
+        memcpy(_data + address, &value, sizeof(T));
+        return value;
+    }
+};
+
+inline EEPROMClass EEPROM;
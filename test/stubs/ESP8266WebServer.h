@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <FS.h>
+#include <functional>
+#include <map>
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+// blocking web server, requests are run by test through request() and the last
+// response is kept for inspection
+class ESP8266WebServer {
+    public:
+    typedef std::function<void()> THandlerFunction;
+    typedef std::function<String(FS&, const String&)> ETagFunction;
+
+    struct Response {
+        int code;
+        std::string contentType;
+        std::string body;
+    };
+
+    Response response;
+    uint16_t chunks = 0;    // sendContent() calls of last response, closing empty one included
+
+    private:
+    struct Route {
+        std::string uri;
+        HTTPMethod method;
+        THandlerFunction handler;
+    };
+
+    std::vector<Route> _routes;
+    std::map<std::string, std::string> _args;
+    WiFiClient _client;
+
+    public:
+    ESP8266WebServer(uint16_t) {}
+
+    void on(const char* uri, HTTPMethod method, THandlerFunction handler) {
+        _routes.push_back(Route{ uri, method, handler });
+    }
+
+    void serveStatic(const char*, FS&, const char*, const char* = nullptr) {}
+    void enableETag(bool, ETagFunction = nullptr) {}
+    void begin() {}
+    void handleClient() {}
+
+    String arg(const char* name) {
+        auto found = _args.find(name);
+        return found == _args.end() ? String() : String(found->second);
+    }
+
+    bool hasArg(const char* name) {
+        return _args.count(name) > 0;
+    }
+
+    WiFiClient& client() {
+        return _client;
+    }
+
+    void send(int code, const char* contentType, const char* content, size_t length) {
+        response = Response{ code, contentType, std::string(content, length) };
+    }
+
+    void send(int code, const char* contentType, const char* content) {
+        send(code, contentType, content, strlen(content));
+    }
+
+    void setContentLength(size_t) {}
+
+    // chunk of response started with unknown content length
+    void sendContent(const char* content, size_t length) {
+        response.body.append(content, length);
+        chunks++;
+    }
+
+    void sendContent(const char* content) {
+        sendContent(content, strlen(content));
+    }
+
+    // run handler of route as if request arrived on connection, returns false when
+    // no route matches
+    bool request(HTTPMethod method, const char* uri, const std::map<std::string, std::string>& args = {},
+        WiFiClient client = WiFiClient()) {
+        for (Route& route : _routes) {
+            if (route.uri == uri && (route.method == HTTP_ANY || route.method == method)) {
+                _args = args;
+                _client = client;
+                response = Response{ 0, "", "" };
+                chunks = 0;
+                route.handler();
+                return true;
+            }
+        }
+        return false;
+    }
+};
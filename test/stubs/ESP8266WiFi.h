@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include "lwip/ip_addr.h"
+#include "WiFiClient.h"
+
+typedef enum { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 } wl_status_t;
+typedef enum { WIFI_NONE_SLEEP = 0, WIFI_LIGHT_SLEEP = 1, WIFI_MODEM_SLEEP = 2 } WiFiSleepType_t;
+
+// station of simulated node, names resolve from hosts table
+class ESP8266WiFiClass {
+    public:
+    std::map<std::string, uint32_t> hosts;
+    WiFiSleepType_t sleepMode = WIFI_NONE_SLEEP;
+
+    bool setSleepMode(WiFiSleepType_t type) {
+        sleepMode = type;
+        return true;
+    }
+
+    bool isConnected() { return host::node().connected; }
+    wl_status_t status() { return isConnected() ? WL_CONNECTED : WL_DISCONNECTED; }
+    IPAddress localIP() { return IPAddress(host::node().ip); }
+    IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+    IPAddress broadcastIP() { return IPAddress(host::node().ip | 0xFF000000UL); }
+
+    int hostByName(const char* name, IPAddress& result) {
+        if (result.fromString(name)) {
+            return 1;
+        }
+        auto found = hosts.find(name);
+        if (found == hosts.end()) {
+            return 0;
+        }
+        result = IPAddress(found->second);
+        return 1;
+    }
+};
+
+inline ESP8266WiFiClass WiFi;
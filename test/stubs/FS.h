@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+
+// in-memory file system, test fills files by path
+namespace fs {
+
+class File {
+    private:
+    std::shared_ptr<const std::string> _data;
+    size_t _pos;
+
+    public:
+    File() : _pos(0) {}
+    File(std::shared_ptr<const std::string> data) : _data(data), _pos(0) {}
+
+    operator bool() const { return _data != nullptr; }
+    int available() { return _data ? _data->size() - _pos : 0; }
+    size_t size() const { return _data ? _data->size() : 0; }
+
+    int read() {
+        return available() ? (uint8_t)(*_data)[_pos++] : -1;
+    }
+
+    String readStringUntil(char terminator) {
+        String s;
+        for (int c = read(); c >= 0 && c != terminator; c = read()) {
+            s += (char)c;
+        }
+        return s;
+    }
+
+    void close() {
+        _data.reset();
+    }
+};
+
+class FS {
+    public:
+    std::map<std::string, std::string> files;
+
+    File open(const char* path, const char*) {
+        auto found = files.find(path);
+        return found == files.end() ? File() : File(std::make_shared<const std::string>(found->second));
+    }
+
+    bool exists(const char* path) {
+        return files.count(path) > 0;
+    }
+};
+
+}
+
+using fs::File;
+using fs::FS;
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+#include <memory>
+
+// TCP connection whose peer is the test: written bytes collect in received, send
+// buffer room is set by test. Copies share one connection like core WiFiClient.
+class WiFiClient : public Print {
+    public:
+    struct Connection {
+        std::string received;
+        size_t room = 5744;     // free TCP send buffer, 4 segments of 1436 bytes
+        bool connected = true;
+        bool noDelay = false;
+    };
+
+    std::shared_ptr<Connection> connection;
+
+    WiFiClient() {}
+    WiFiClient(std::shared_ptr<Connection> c) : connection(c) {}
+
+    uint8_t connected() { return connection && connection->connected; }
+    size_t availableForWrite() { return connected() ? connection->room : 0; }
+    void setNoDelay(bool noDelay) { if (connection) connection->noDelay = noDelay; }
+
+    void stop() {
+        if (connection) {
+            connection->connected = false;
+        }
+    }
+
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t* data, size_t len) override {
+        if (!connected()) {
+            return 0;
+        }
+        connection->received.append((const char*)data, len);
+        return len;
+    }
+
+    using Print::write;
+};
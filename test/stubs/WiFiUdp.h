@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Udp.h>
+#include <deque>
+#include "ESP8266WiFi.h"
+
+// WiFiUDP over loopback segment of host.h, received datagrams queue up until
+// parsePacket() like in lwIP receive buffer
+class WiFiUDP : public UDP {
+    private:
+    struct Datagram {
+        uint32_t from;
+        uint16_t port;
+        std::vector<uint8_t> data;
+    };
+
+    host::Endpoint _endpoint;
+    bool _bound;
+    std::deque<Datagram> _received;
+    Datagram _current;
+    size_t _read;
+    uint32_t _to;
+    uint16_t _toPort;
+    std::vector<uint8_t> _sending;
+
+    public:
+    WiFiUDP() : _endpoint(), _bound(false), _read(0), _to(0), _toPort(0) {
+        _current = Datagram{ 0, 0, {} };
+    }
+
+    ~WiFiUDP() {
+        stop();
+    }
+
+    uint8_t begin(uint16_t port) override {
+        stop();
+        _endpoint.node = host::current;
+        _endpoint.port = port;
+        _endpoint.group = 0;
+        _endpoint.deliver = [this](uint32_t from, uint16_t fromPort, const std::vector<uint8_t>& data) {
+            _received.push_back(Datagram{ from, fromPort, data });
+        };
+        host::bind(&_endpoint);
+        _bound = true;
+        return 1;
+    }
+
+    uint8_t beginMulticast(IPAddress iface, IPAddress group, uint16_t port) {
+        begin(port);
+        _endpoint.group = group;
+        _endpoint.iface = iface;
+        return 1;
+    }
+
+    void stop() override {
+        if (_bound) {
+            host::unbind(&_endpoint);
+            _bound = false;
+        }
+        _received.clear();
+    }
+
+    int beginPacket(IPAddress ip, uint16_t port) override {
+        _to = ip;
+        _toPort = port;
+        _sending.clear();
+        return 1;
+    }
+
+    int endPacket() override {
+        const size_t selected = host::current;
+        host::select(_bound ? _endpoint.node : selected);
+        const bool sent = host::sendto(_endpoint.port, _to, _toPort, _sending.data(), _sending.size());
+        host::select(selected);
+        _sending.clear();
+        return sent;
+    }
+
+    size_t write(uint8_t c) override {
+        _sending.push_back(c);
+        return 1;
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        _sending.insert(_sending.end(), buf, buf + size);
+        return size;
+    }
+
+    int parsePacket() override {
+        if (_received.empty()) {
+            return 0;
+        }
+        _current = _received.front();
+        _received.pop_front();
+        _read = 0;
+        return _current.data.size();
+    }
+
+    int available() override {
+        return _current.data.size() - _read;
+    }
+
+    int read() override {
+        return _read < _current.data.size() ? _current.data[_read++] : -1;
+    }
+
+    int read(unsigned char* buf, size_t len) override {
+        const size_t n = std::min(len, _current.data.size() - _read);
+        memcpy(buf, _current.data.data() + _read, n);
+        _read += n;
+        return n;
+    }
+
+    void flush() override {
+        _read = _current.data.size();
+    }
+
+    IPAddress remoteIP() override {
+        return IPAddress(_current.from);
+    }
+
+    uint16_t remotePort() override {
+        return _current.port;
+    }
+
+    using UDP::write;
+};
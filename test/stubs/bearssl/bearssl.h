@@ -0,0 +1,142 @@
+#pragma once
+
+// BearSSL stand-in, HMAC with SHA-256 only
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t state[8];
+    uint8_t block[64];
+    uint64_t count;
+} br_sha256_context;
+
+typedef struct {
+    int id;
+} br_hash_class;
+
+inline const br_hash_class br_sha256_vtable = { 4 };
+
+inline void br_sha256_init(br_sha256_context* ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->count = 0;
+}
+
+inline void br_sha256_round(uint32_t* state, const uint8_t* block) {
+    static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+    auto rotr = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+        const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+inline void br_sha256_update(br_sha256_context* ctx, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len--) {
+        ctx->block[ctx->count++ % 64] = *p++;
+        if (ctx->count % 64 == 0) {
+            br_sha256_round(ctx->state, ctx->block);
+        }
+    }
+}
+
+inline void br_sha256_out(const br_sha256_context* ctx, void* out) {
+    br_sha256_context c = *ctx;
+    const uint64_t bits = c.count * 8;
+    const uint8_t pad = 0x80, zero = 0;
+    br_sha256_update(&c, &pad, 1);
+    while (c.count % 64 != 56) {
+        br_sha256_update(&c, &zero, 1);
+    }
+    for (int i = 7; i >= 0; i--) {
+        const uint8_t byte = bits >> (i * 8);
+        br_sha256_update(&c, &byte, 1);
+    }
+    uint8_t* o = (uint8_t*)out;
+    for (int i = 0; i < 8; i++) {
+        o[i * 4] = c.state[i] >> 24;
+        o[i * 4 + 1] = c.state[i] >> 16;
+        o[i * 4 + 2] = c.state[i] >> 8;
+        o[i * 4 + 3] = c.state[i];
+    }
+}
+
+typedef struct {
+    const br_hash_class* dig_vtable;
+    uint8_t ipad[64];
+    uint8_t opad[64];
+} br_hmac_key_context;
+
+typedef struct {
+    br_sha256_context inner;
+    const br_hmac_key_context* key;
+    size_t out_len;
+} br_hmac_context;
+
+inline void br_hmac_key_init(br_hmac_key_context* kc, const br_hash_class* digest, const void* key, size_t len) {
+    uint8_t block[64] = {};
+    if (len > 64) {
+        br_sha256_context ctx;
+        br_sha256_init(&ctx);
+        br_sha256_update(&ctx, key, len);
+        br_sha256_out(&ctx, block);
+    }
+    else memcpy(block, key, len);
+    kc->dig_vtable = digest;
+    for (int i = 0; i < 64; i++) {
+        kc->ipad[i] = block[i] ^ 0x36;
+        kc->opad[i] = block[i] ^ 0x5C;
+    }
+}
+
+inline void br_hmac_init(br_hmac_context* ctx, const br_hmac_key_context* kc, size_t out_len) {
+    br_sha256_init(&ctx->inner);
+    br_sha256_update(&ctx->inner, kc->ipad, 64);
+    ctx->key = kc;
+    ctx->out_len = out_len && out_len < 32 ? out_len : 32;
+}
+
+inline void br_hmac_update(br_hmac_context* ctx, const void* data, size_t len) {
+    br_sha256_update(&ctx->inner, data, len);
+}
+
+inline size_t br_hmac_out(const br_hmac_context* ctx, void* out) {
+    uint8_t digest[32];
+    br_sha256_out(&ctx->inner, digest);
+    br_sha256_context outer;
+    br_sha256_init(&outer);
+    br_sha256_update(&outer, ctx->key->opad, 64);
+    br_sha256_update(&outer, digest, sizeof(digest));
+    br_sha256_out(&outer, digest);
+    memcpy(out, digest, ctx->out_len);
+    return ctx->out_len;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// nodemcuv2 4m2m layout: filesystem ends at 0x3FA000, EEPROM sector at 0x3FB000
+#define FS_PHYS_ADDR 0x200000u
+#define FS_PHYS_SIZE 0x1FA000u
+#define CONFIG_STORE_SECTOR_A 0x3FB
+#define CONFIG_STORE_SECTOR_B 0x3FA
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <functional>
+#include <vector>
+
+// Simulated hardware behind the Arduino stand-ins. True time advances only when
+// a test says so, every node has its own oscillator error, system clock, chip id,
+// IP address and RTC memory, and datagrams between nodes travel over a loopback
+// segment with configurable delay. Single node tests use node 0 and never notice.
+namespace host {
+
+struct Node {
+    uint32_t chipId;
+    uint32_t ip;                // lwIP byte order, first octet in lowest byte
+    int64_t driftPpb;           // oscillator error, positive runs fast
+    int64_t boot;               // true time of last reset, us
+    int64_t rtcStart;           // true time of power up, RTC timer counts from it
+    int64_t offset;             // system clock minus raw clock, us
+    uint32_t rtcMemory[128];
+    bool connected;
+};
+
+inline int64_t now = 1700000000LL * 1000000;    // true time, us
+inline std::vector<Node> nodes(1, Node{ 0x00C10C, 0x5300A8C0, 0, now, now, 0, {}, true });
+inline size_t current = 0;
+inline bool verbose = getenv("HOST_VERBOSE") != nullptr;
+
+inline Node& node() {
+    return nodes[current];
+}
+
+// add node with IP 192.168.0.<host>, returns its index
+inline size_t addNode(uint8_t host, uint32_t chipId, int64_t driftPpb = 0) {
+    nodes.push_back(Node{ chipId, 0x0000A8C0 | (uint32_t)host << 24, driftPpb, now, now, 0, {}, true });
+    return nodes.size() - 1;
+}
+
+inline void select(size_t index) {
+    current = index;
+}
+
+// microseconds counted by oscillator of node since its reset
+inline int64_t raw(const Node& n) {
+    const int64_t elapsed = now - n.boot;
+    return elapsed + elapsed / 1000 * n.driftPpb / 1000000;
+}
+
+inline int64_t raw() {
+    return raw(node());
+}
+
+inline int64_t wallClock() {
+    return raw() + node().offset;
+}
+
+inline void setWallClock(int64_t us) {
+    node().offset = us - raw();
+}
+
+// software or watchdog reset, RTC memory and RTC timer survive
+inline void reset() {
+    node().boot = now;
+    node().offset = 0;
+}
+
+// power cycle, RTC memory is lost
+inline void powerCycle() {
+    reset();
+    node().rtcStart = now;
+    memset(node().rtcMemory, 0xA5, sizeof(node().rtcMemory));
+}
+
+// events (datagram delivery, DNS answers) run at their true time on their node
+struct Event {
+    int64_t at;
+    size_t node;
+    std::function<void()> run;
+};
+
+inline std::vector<Event> events;
+
+inline void schedule(int64_t delay, size_t target, std::function<void()> run) {
+    events.push_back(Event{ now + delay, target, run });
+}
+
+// advance true time, running due events in order
+inline void advance(int64_t us) {
+    const int64_t end = now + us;
+    for (;;) {
+        size_t next = events.size();
+        for (size_t i = 0; i < events.size(); i++) {
+            if (events[i].at <= end && (next == events.size() || events[i].at < events[next].at)) {
+                next = i;
+            }
+        }
+        if (next == events.size()) {
+            break;
+        }
+        Event event = events[next];
+        events.erase(events.begin() + next);
+        const size_t selected = current;
+        now = event.at > now ? event.at : now;
+        current = event.node;
+        event.run();
+        current = selected;
+    }
+    now = end;
+}
+
+// loopback segment: datagram delay in us, returned by function so tests can add jitter
+inline std::function<int64_t()> latency = [] { return (int64_t)300; };
+inline int64_t dnsLatency = 20000;  // name lookup answer delay, us
+
+inline uint32_t random() {
+    static uint32_t state = 2463534242UL;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+inline bool isBroadcast(uint32_t ip) {
+    return ip == 0xFFFFFFFFUL || (ip >> 24) == 0xFF;
+}
+
+inline bool isMulticast(uint32_t ip) {
+    return (ip & 0xF0) == 0xE0;
+}
+
+struct Endpoint {
+    size_t node;
+    uint16_t port;
+    uint32_t group;             // joined multicast group, zero for none
+    std::function<void(uint32_t from, uint16_t fromPort, const std::vector<uint8_t>& data)> deliver;
+    uint32_t iface = 0;         // address group was joined on, membership is lost when it changes
+};
+
+inline std::vector<Endpoint*> endpoints;
+
+inline void bind(Endpoint* endpoint) {
+    endpoints.push_back(endpoint);
+}
+
+inline void unbind(Endpoint* endpoint) {
+    for (size_t i = 0; i < endpoints.size(); i++) {
+        if (endpoints[i] == endpoint) {
+            endpoints.erase(endpoints.begin() + i);
+            return;
+        }
+    }
+}
+
+// send datagram from current node, broadcast and multicast reach every other node
+inline bool sendto(uint16_t fromPort, uint32_t to, uint16_t port, const uint8_t* data, size_t len) {
+    if (!node().connected) {
+        return false;
+    }
+    const uint32_t from = node().ip;
+    const std::vector<uint8_t> payload(data, data + len);
+    for (Endpoint* e : endpoints) {
+        const bool match = e->port == port && nodes[e->node].connected &&
+            (isBroadcast(to) ? e->node != current :
+             isMulticast(to) ? e->group == to && e->iface == nodes[e->node].ip && e->node != current :
+             nodes[e->node].ip == to);
+        if (match) {
+            Endpoint* target = e;
+            schedule(latency(), e->node, [target, from, fromPort, payload] {
+                for (Endpoint* bound : endpoints) {
+                    if (bound == target) {
+                        target->deliver(from, fromPort, payload);
+                    }
+                }
+            });
+        }
+    }
+    return true;
+}
+
+// simulated SPI flash, 4 MB of NOR cells programmed from 1 to 0. Power fail is
+// injected by write budget: programming stops after given number of bytes, erase
+// counts as one byte and leaves sector half erased, further operations fail
+// until power is restored.
+struct Flash {
+    static constexpr uint32_t SIZE = 0x400000;
+    static constexpr uint32_t SECTOR = 4096;
+    std::vector<uint8_t> cells = std::vector<uint8_t>(SIZE, 0xFF);
+    int64_t budget = -1;        // bytes left before power fails, negative for no limit
+    bool failed = false;
+    uint32_t written = 0;       // bytes programmed or erases done, for sizing budgets
+
+    bool consume() {
+        if (failed) {
+            return false;
+        }
+        if (budget == 0) {
+            failed = true;
+            return false;
+        }
+        if (budget > 0) {
+            budget--;
+        }
+        written++;
+        return true;
+    }
+
+    bool erase(uint32_t sector) {
+        if (sector >= SIZE / SECTOR) {
+            return false;
+        }
+        uint8_t* start = cells.data() + sector * SECTOR;
+        if (failed) {
+            return false;
+        }
+        if (!consume()) {
+            memset(start, 0xFF, SECTOR / 2);
+            return false;
+        }
+        memset(start, 0xFF, SECTOR);
+        return true;
+    }
+
+    bool write(uint32_t address, const uint8_t* data, size_t len) {
+        if (address % 4 || len % 4 || address + len > SIZE) {
+            return false;
+        }
+        for (size_t i = 0; i < len; i++) {
+            if (!consume()) {
+                return false;
+            }
+            cells[address + i] &= data[i];
+        }
+        return true;
+    }
+
+    bool read(uint32_t address, uint8_t* data, size_t len) const {
+        if (address + len > SIZE) {
+            return false;
+        }
+        memcpy(data, cells.data() + address, len);
+        return true;
+    }
+
+    void restore() {
+        budget = -1;
+        failed = false;
+    }
+};
+
+inline Flash flash;
+
+inline uint16_t analog = 0;     // A0 reading
+
+}
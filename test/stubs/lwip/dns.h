@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include "ip_addr.h"
+#include "ESP8266WiFi.h"
+
+typedef void (*dns_found_callback)(const char* name, const ip_addr_t* ipaddr, void* callback_arg);
+
+// lookup answered from WiFi.hosts after host::dnsLatency on calling node,
+// literal addresses complete at once
+inline err_t dns_gethostbyname(const char* hostname, ip_addr_t* addr, dns_found_callback found, void* arg) {
+    IPAddress literal;
+    if (literal.fromString(hostname)) {
+        addr->addr = literal;
+        return ERR_OK;
+    }
+    const std::string name(hostname);
+    host::schedule(host::dnsLatency, host::current, [name, found, arg] {
+        auto entry = WiFi.hosts.find(name);
+        const ip_addr_t address = { entry != WiFi.hosts.end() ? entry->second : 0 };
+        found(name.c_str(), entry != WiFi.hosts.end() ? &address : nullptr, arg);
+    });
+    return ERR_INPROGRESS;
+}
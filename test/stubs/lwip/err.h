@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+
+#define ERR_OK          0
+#define ERR_MEM         -1
+#define ERR_INPROGRESS  -5
+#define ERR_VAL         -6
+#define ERR_USE         -8
+#define ERR_ARG         -16
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "err.h"
+
+struct ip_addr_t {
+    u32_t addr;
+};
+
+inline const ip_addr_t ip_addr_any = { 0 };
+
+#define IP_ANY_TYPE (&ip_addr_any)
+#define ip_addr_get_ip4_u32(ip) ((ip)->addr)
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include "err.h"
+
+enum pbuf_layer { PBUF_TRANSPORT };
+enum pbuf_type { PBUF_RAM };
+
+// single buffer pbuf, chains are never built by stand-in
+struct pbuf {
+    pbuf* next;
+    void* payload;
+    u16_t tot_len;
+    u16_t len;
+};
+
+inline pbuf* pbuf_alloc(pbuf_layer, u16_t length, pbuf_type) {
+    pbuf* p = (pbuf*)malloc(sizeof(pbuf) + length);
+    if (p) {
+        p->next = nullptr;
+        p->payload = p + 1;
+        p->tot_len = p->len = length;
+    }
+    return p;
+}
+
+inline u8_t pbuf_free(pbuf* p) {
+    free(p);
+    return 1;
+}
+
+inline err_t pbuf_take(pbuf* p, const void* data, u16_t length) {
+    if (length > p->tot_len) {
+        return ERR_ARG;
+    }
+    memcpy(p->payload, data, length);
+    return ERR_OK;
+}
+
+inline u16_t pbuf_copy_partial(const pbuf* p, void* data, u16_t length, u16_t offset) {
+    if (offset >= p->tot_len) {
+        return 0;
+    }
+    const u16_t n = length < p->tot_len - offset ? length : p->tot_len - offset;
+    memcpy(data, (const uint8_t*)p->payload + offset, n);
+    return n;
+}
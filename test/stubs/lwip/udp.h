@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ip_addr.h"
+#include "pbuf.h"
+
+#define SOF_BROADCAST 0x20
+
+struct udp_pcb;
+typedef void (*udp_recv_fn)(void* arg, udp_pcb* pcb, pbuf* p, const ip_addr_t* addr, u16_t port);
+
+// raw lwIP UDP over loopback segment of host.h, receive callback runs from
+// host::advance() on receiving node like lwIP runs it from network interrupt
+struct udp_pcb {
+    host::Endpoint endpoint;
+    u8_t so_options;
+    udp_recv_fn recv;
+    void* recv_arg;
+};
+
+#define ip_set_option(pcb, option) ((pcb)->so_options |= (option))
+
+inline udp_pcb* udp_new() {
+    udp_pcb* pcb = new udp_pcb();
+    pcb->endpoint.node = host::current;
+    return pcb;
+}
+
+inline void udp_remove(udp_pcb* pcb) {
+    host::unbind(&pcb->endpoint);
+    delete pcb;
+}
+
+inline err_t udp_bind(udp_pcb* pcb, const ip_addr_t*, u16_t port) {
+    pcb->endpoint.port = port;
+    pcb->endpoint.deliver = [pcb](uint32_t from, uint16_t fromPort, const std::vector<uint8_t>& data) {
+        pbuf* p = pbuf_alloc(PBUF_TRANSPORT, data.size(), PBUF_RAM);
+        pbuf_take(p, data.data(), data.size());
+        const ip_addr_t addr = { from };
+        if (pcb->recv) {
+            pcb->recv(pcb->recv_arg, pcb, p, &addr, fromPort);
+        }
+        else pbuf_free(p);
+    };
+    host::bind(&pcb->endpoint);
+    return ERR_OK;
+}
+
+inline void udp_recv(udp_pcb* pcb, udp_recv_fn recv, void* arg) {
+    pcb->recv = recv;
+    pcb->recv_arg = arg;
+}
+
+inline err_t udp_sendto(udp_pcb* pcb, pbuf* p, const ip_addr_t* addr, u16_t port) {
+    if (host::isBroadcast(addr->addr) && !(pcb->so_options & SOF_BROADCAST)) {
+        return ERR_VAL;
+    }
+    return host::sendto(pcb->endpoint.port, addr->addr, port, (const uint8_t*)p->payload, p->tot_len) ? ERR_OK : ERR_USE;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+#define WIFI_SSID "native"
+#define WIFI_PASSWORD "native"
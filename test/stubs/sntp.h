@@ -0,0 +1,10 @@
+#pragma once
+
+inline bool& host_sntp() {
+    static bool enabled = false;
+    return enabled;
+}
+
+inline bool sntp_enabled() { return host_sntp(); }
+inline void sntp_init() { host_sntp() = true; }
+inline void sntp_stop() { host_sntp() = false; }
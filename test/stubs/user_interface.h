@@ -0,0 +1,13 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define HOST_RTC_TICK_US 6      // RTC timer period, calibration value is Q12 us per tick
+
+inline uint32_t system_get_rtc_time() {
+    return (host::now - host::node().rtcStart) / HOST_RTC_TICK_US;
+}
+
+inline uint32_t system_rtc_clock_cali_proc() {
+    return HOST_RTC_TICK_US << 12;
+}
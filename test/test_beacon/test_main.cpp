@@ -0,0 +1,147 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <memory>
+#include "beacon.h"
+
+#define KEY "0123456789abcdef"
+#define LEADER 0
+#define FOLLOWERS 2
+
+// leader on node 0 with true time, followers with fast and slow oscillators
+static std::vector<std::unique_ptr<TimeBeacon>> beacons;
+static std::vector<size_t> followers;
+static size_t sniffer;
+static host::Endpoint capture;
+static std::vector<uint8_t> captured;
+
+static int64_t wallClock(size_t node) {
+    return host::raw(host::nodes[node]) + host::nodes[node].offset;
+}
+
+// phase of follower clock to leader clock, us
+static int64_t phase(size_t node) {
+    return wallClock(node) - wallClock(LEADER);
+}
+
+// firmware start on node, beacon object is created from scratch like after reset
+static void boot(size_t node, uint8_t role) {
+    host::select(node);
+    beacons[node].reset(new TimeBeacon());
+    TEST_ASSERT_TRUE(beacons[node]->begin(role, KEY));
+    host::select(0);
+}
+
+// run loops of all nodes
+static void run(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        for (size_t node = 0; node < beacons.size(); node++) {
+            if (beacons[node]) {
+                host::select(node);
+                beacons[node]->poll(true);
+            }
+        }
+        host::select(0);
+        host::advance(1000);
+    }
+}
+
+static void replay(const std::vector<uint8_t>& packet) {
+    host::select(sniffer);
+    host::sendto(BEACON_PORT, 0xFFFFFFFFUL, BEACON_PORT, packet.data(), packet.size());
+    host::select(0);
+}
+
+void setUp() {
+    if (followers.empty()) {
+        followers.push_back(host::addNode(21, 0xF00001, 40000));
+        followers.push_back(host::addNode(22, 0xF00002, -25000));
+        sniffer = host::addNode(99, 0x5A1FF);
+        capture = host::Endpoint{ sniffer, BEACON_PORT, 0,
+            [](uint32_t, uint16_t, const std::vector<uint8_t>& data) { captured = data; } };
+        host::bind(&capture);
+        beacons.resize(host::nodes.size());
+    }
+    host::select(LEADER);
+    host::setWallClock(host::now);
+    for (size_t node : followers) {
+        host::select(node);
+        host::powerCycle();     // clock never set
+    }
+    boot(LEADER, BEACON_LEADER);
+    for (size_t node : followers) {
+        boot(node, BEACON_FOLLOWER);
+    }
+}
+
+void tearDown() {
+}
+
+void test_followers_phase_lock_to_leader() {
+    run(120000);
+    for (size_t node : followers) {
+        TEST_ASSERT_TRUE(beacons[node]->isLocked());
+        TEST_ASSERT_INT64_WITHIN(2000, 0, phase(node));
+        TEST_ASSERT_INT32_WITHIN(5000, -host::nodes[node].driftPpb, beacons[node]->getDrift());
+    }
+}
+
+void test_restarted_leader_is_followed_without_gap() {
+    run(60000);
+    host::select(LEADER);
+    host::reset();
+    host::setWallClock(host::now);      // time restored from RTC memory or NTP
+    boot(LEADER, BEACON_LEADER);
+    for (uint8_t s = 0; s < 15; s++) {
+        run(1000);
+        for (size_t node : followers) {
+            TEST_ASSERT_TRUE(beacons[node]->isLocked());
+        }
+    }
+    for (size_t node : followers) {
+        TEST_ASSERT_INT64_WITHIN(2000, 0, phase(node));
+    }
+}
+
+void test_replayed_beacon_rejected_after_leader_is_lost() {
+    run(30000);
+    const std::vector<uint8_t> old = captured;
+    run(30000);
+    host::select(LEADER);
+    beacons[LEADER]->begin(BEACON_OFF, KEY);
+    host::select(0);
+    run(BEACON_TIMEOUT_MS + 1000);
+    TEST_ASSERT_FALSE(beacons[followers[0]]->isLocked());
+
+    const int64_t before = phase(followers[0]);
+    replay(old);
+    run(100);
+    TEST_ASSERT_FALSE(beacons[followers[0]]->isLocked());
+    TEST_ASSERT_INT64_WITHIN(1000, before, phase(followers[0]));
+}
+
+void test_replayed_beacon_rejected_by_restarted_follower_with_valid_clock() {
+    run(10000);
+    const std::vector<uint8_t> old = captured;
+    run(BEACON_ACCEPT_US / 1000 + 10000);
+    host::select(LEADER);
+    beacons[LEADER]->begin(BEACON_OFF, KEY);
+
+    const size_t node = followers[0];
+    host::select(node);
+    host::reset();
+    host::setWallClock(wallClock(LEADER));  // restored from RTC memory
+    boot(node, BEACON_FOLLOWER);
+    replay(old);
+    run(100);
+    TEST_ASSERT_FALSE(beacons[node]->isLocked());
+    TEST_ASSERT_INT64_WITHIN(1000, 0, phase(node));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_followers_phase_lock_to_leader);
+    RUN_TEST(test_restarted_leader_is_followed_without_gap);
+    RUN_TEST(test_replayed_beacon_rejected_after_leader_is_lost);
+    RUN_TEST(test_replayed_beacon_rejected_by_restarted_follower_with_valid_clock);
+    return UNITY_END();
+}
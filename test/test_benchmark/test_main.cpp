@@ -0,0 +1,77 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "configuration.h"
+#include "display.h"
+#include "mytime.h"
+#include "jsonwriter.h"
+#include "benchmark.h"
+
+#define MIDNIGHT 1700006400L
+
+static Configuration state;
+static ClockDisplay display;
+static uint8_t blob[1024];
+
+void setUp() {
+    host::verbose = true;   // results are the point of this suite
+    NtpHelper::initializeTimezone("UTC0");
+    state.loadDefaults();
+    display.initialize(state.displayBrightness, state.displayColors);
+    display.setFace(FACE_CLASSIC);
+}
+
+void tearDown() {
+}
+
+// allocations per call of callback, counted by wrapped malloc family
+template <typename Callback>
+static uint32_t allocations(const char* name, Callback callback) {
+    const uint32_t before = Benchmark::allocations();
+    Benchmark::run(name, callback);
+    return Benchmark::allocations() - before;
+}
+
+void test_allocations_are_counted() {
+    TEST_ASSERT_GREATER_OR_EQUAL(BENCHMARK_ITERATIONS, allocations("malloc", [](uint16_t) {
+        void* volatile ptr = malloc(16);
+        free(ptr);
+    }));
+    TEST_ASSERT_GREATER_OR_EQUAL(BENCHMARK_ITERATIONS, allocations("getColorScheme", [](uint16_t) {
+        display.getColorScheme();
+    }));
+}
+
+void test_render_does_not_allocate() {
+    TEST_ASSERT_EQUAL(0, allocations("stripUpdate", [](uint16_t i) { display.stripUpdate(MIDNIGHT + i); }));
+    display.setFace(FACE_STEPPED);
+    TEST_ASSERT_EQUAL(0, allocations("stripUpdate stepped", [](uint16_t i) { display.stripUpdate(MIDNIGHT + i); }));
+}
+
+void test_json_does_not_allocate() {
+    TEST_ASSERT_EQUAL(0, allocations("JsonWriter", [](uint16_t i) {
+        char buf[256], colors[COLOR_SCHEME_SIZE];
+        JsonWriter json(buf, sizeof(buf));
+        json.add("brightness", (long)i)
+            .add("colors", display.getColorScheme(colors))
+            .add("ntpserver1", state.timeServer1)
+            .add("ntpsynced", true)
+            .end();
+        Benchmark::keep(json.length());
+    }));
+}
+
+void test_checksums_do_not_allocate() {
+    TEST_ASSERT_EQUAL(0, allocations("crc16", [](uint16_t) { Benchmark::keep(state.calculateChecksum()); }));
+    TEST_ASSERT_EQUAL(0, allocations("crc16 bitwise 1K", [](uint16_t) { Benchmark::keep(Checksum::crc16Bitwise(blob, sizeof(blob))); }));
+    TEST_ASSERT_EQUAL(0, allocations("crc16 table 1K", [](uint16_t) { Benchmark::keep(Checksum::crc16(blob, sizeof(blob))); }));
+    TEST_ASSERT_EQUAL(0, allocations("crc32 slice-by-4 1K", [](uint16_t) { Benchmark::keep(Checksum::crc32Slice4(blob, sizeof(blob))); }));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_allocations_are_counted);
+    RUN_TEST(test_render_does_not_allocate);
+    RUN_TEST(test_json_does_not_allocate);
+    RUN_TEST(test_checksums_do_not_allocate);
+    return UNITY_END();
+}
@@ -0,0 +1,68 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "checksum.h"
+
+// standard check input of CRC catalogue
+static const uint8_t CHECK[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_crc16_modbus_check_value() {
+    TEST_ASSERT_EQUAL_HEX16(0x4B37, Checksum::crc16(CHECK, sizeof(CHECK)));
+    TEST_ASSERT_EQUAL_HEX16(0x4B37, Checksum::crc16Bitwise(CHECK, sizeof(CHECK)));
+}
+
+// table driven crc16 replaces bitwise loop of stored records, results must not change
+void test_crc16_table_matches_bitwise() {
+    uint8_t data[300];
+    for (uint16_t i = 0; i < sizeof(data); i++) {
+        data[i] = i * 131 + 17;
+    }
+    for (uint16_t size = 0; size <= sizeof(data); size++) {
+        for (uint16_t init : { 0xFFFF, 0x0000, 0x1D0F }) {
+            TEST_ASSERT_EQUAL_HEX16(Checksum::crc16Bitwise(data, size, init), Checksum::crc16(data, size, init));
+        }
+    }
+}
+
+void test_crc32_check_value() {
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, Checksum::crc32(CHECK, sizeof(CHECK)));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, Checksum::crc32Slice4(CHECK, sizeof(CHECK)));
+    TEST_ASSERT_EQUAL_HEX32(0, Checksum::crc32(CHECK, 0));
+}
+
+void test_crc32_slices_match_bytewise_at_any_alignment() {
+    uint8_t data[256 + 3];
+    for (uint16_t i = 0; i < sizeof(data); i++) {
+        data[i] = i * 7 + 1;
+    }
+    for (uint8_t start = 0; start < 4; start++) {
+        for (uint16_t size = 0; size <= 256; size++) {
+            uint32_t expected = 0;
+            for (uint16_t i = 0; i < size; i++) {
+                expected = Checksum::crc32(data + start + i, 1, expected);
+            }
+            TEST_ASSERT_EQUAL_HEX32(expected, Checksum::crc32Slice4(data + start, size));
+            TEST_ASSERT_EQUAL_HEX32(expected, Checksum::crc32(data + start, size));
+        }
+    }
+}
+
+void test_crc_continues_over_chunks() {
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, Checksum::crc32(CHECK + 4, 5, Checksum::crc32(CHECK, 4)));
+    TEST_ASSERT_EQUAL_HEX16(0x4B37, Checksum::crc16(CHECK + 4, 5, Checksum::crc16(CHECK, 4)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc16_modbus_check_value);
+    RUN_TEST(test_crc16_table_matches_bitwise);
+    RUN_TEST(test_crc32_check_value);
+    RUN_TEST(test_crc32_slices_match_bytewise_at_any_alignment);
+    RUN_TEST(test_crc_continues_over_chunks);
+    return UNITY_END();
+}
@@ -0,0 +1,145 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "configstore.h"
+#include "configuration.h"
+
+#define SECTOR_A CONFIG_STORE_SECTOR_A
+#define SECTOR_B CONFIG_STORE_SECTOR_B
+#define RECORD_SIZE 300
+
+static uint8_t record[RECORD_SIZE];
+
+// record content differs for every sequence number
+static const uint8_t* fill(uint32_t sequence) {
+    for (uint16_t i = 0; i < RECORD_SIZE; i++) {
+        record[i] = sequence * 31 + i;
+    }
+    return record;
+}
+
+// newest committed record seen by freshly started store
+static uint32_t recovered() {
+    ConfigStore store(SECTOR_A, SECTOR_B);
+    TEST_ASSERT_TRUE(store.begin());
+    if (store.isEmpty()) {
+        return 0;
+    }
+    uint8_t data[RECORD_SIZE];
+    TEST_ASSERT_TRUE(store.load(data, sizeof(data)));
+    TEST_ASSERT_EQUAL_MEMORY(fill(store.sequence()), data, RECORD_SIZE);
+    return store.sequence();
+}
+
+// cut power after every byte of saving next record, flash must hold either
+// previous record or the new one, and the store must keep working afterwards
+static void cutEveryByte(uint32_t records) {
+    for (uint32_t sequence = 1; sequence <= records; sequence++) {
+        ConfigStore store(SECTOR_A, SECTOR_B);
+        store.begin();
+        TEST_ASSERT_TRUE(store.save(fill(sequence), RECORD_SIZE));
+    }
+    const std::vector<uint8_t> image = host::flash.cells;
+
+    host::flash.written = 0;
+    {
+        ConfigStore store(SECTOR_A, SECTOR_B);
+        store.begin();
+        TEST_ASSERT_TRUE(store.save(fill(records + 1), RECORD_SIZE));
+    }
+    const uint32_t total = host::flash.written;
+
+    char message[40];
+    for (uint32_t cut = 0; cut < total; cut++) {
+        snprintf(message, sizeof(message), "cut after %u of %u", cut, total);
+        host::flash.cells = image;
+        host::flash.budget = cut;
+        {
+            ConfigStore store(SECTOR_A, SECTOR_B);
+            store.begin();
+            TEST_ASSERT_FALSE_MESSAGE(store.save(fill(records + 1), RECORD_SIZE), message);
+        }
+        host::flash.restore();
+        TEST_ASSERT_EQUAL_MESSAGE(records, recovered(), message);
+
+        // next save after power returns is committed on top of torn one
+        ConfigStore store(SECTOR_A, SECTOR_B);
+        store.begin();
+        TEST_ASSERT_TRUE_MESSAGE(store.save(fill(records + 1), RECORD_SIZE), message);
+        TEST_ASSERT_EQUAL_MESSAGE(records + 1, recovered(), message);
+    }
+}
+
+void setUp() {
+    host::flash.restore();
+    for (uint32_t sector : { SECTOR_A, SECTOR_B }) {
+        host::flash.erase(sector);
+    }
+}
+
+void tearDown() {
+}
+
+void test_power_fail_during_first_save() {
+    cutEveryByte(0);
+}
+
+void test_power_fail_during_append() {
+    cutEveryByte(3);
+}
+
+void test_power_fail_during_sector_switch() {
+    // records of 316 bytes, twelve fill a sector and thirteenth erases other one
+    cutEveryByte(CONFIG_STORE_SECTOR_SIZE / (RECORD_SIZE + 16));
+}
+
+void test_unchanged_record_is_not_written() {
+    ConfigStore store(SECTOR_A, SECTOR_B);
+    store.begin();
+    TEST_ASSERT_TRUE(store.save(fill(1), RECORD_SIZE));
+    host::flash.written = 0;
+    bool unchanged = false;
+    TEST_ASSERT_TRUE(store.save(fill(1), RECORD_SIZE, &unchanged));
+    TEST_ASSERT_TRUE(unchanged);
+    TEST_ASSERT_EQUAL(0, host::flash.written);
+}
+
+void test_foreign_data_is_erased_before_use() {
+    const uint32_t junk = 0x12345678;
+    host::flash.write(SECTOR_B * CONFIG_STORE_SECTOR_SIZE, (const uint8_t*)&junk, sizeof(junk));
+    ConfigStore store(SECTOR_A, SECTOR_B);
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_TRUE(store.isEmpty());
+    TEST_ASSERT_TRUE(store.save(fill(1), RECORD_SIZE));
+    TEST_ASSERT_EQUAL(1, recovered());
+}
+
+// Configuration goes through shared store instance, corrupted record falls back
+// to defaults
+void test_configuration_round_trip() {
+    Configuration stored;
+    stored.loadDefaults();
+    stored.displayBrightness = 120;
+    TEST_ASSERT_TRUE(stored.saveToStore());
+    Configuration loaded;
+    TEST_ASSERT_TRUE(loaded.loadStoredConfigurationOrDefaults());
+    TEST_ASSERT_EQUAL(120, loaded.displayBrightness);
+    TEST_ASSERT_EQUAL_STRING(stored.timeServer1, loaded.timeServer1);
+
+    for (uint32_t sector : { SECTOR_A, SECTOR_B }) {
+        host::flash.cells[sector * CONFIG_STORE_SECTOR_SIZE + 16 + 10] ^= 0xFF;
+    }
+    TEST_ASSERT_FALSE(loaded.loadStoredConfigurationOrDefaults());
+    stored.loadDefaults();
+    TEST_ASSERT_EQUAL(stored.displayBrightness, loaded.displayBrightness);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_power_fail_during_first_save);
+    RUN_TEST(test_power_fail_during_append);
+    RUN_TEST(test_power_fail_during_sector_switch);
+    RUN_TEST(test_unchanged_record_is_not_written);
+    RUN_TEST(test_foreign_data_is_erased_before_use);
+    RUN_TEST(test_configuration_round_trip);
+    return UNITY_END();
+}
@@ -0,0 +1,143 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "configuration.h"
+
+static uint8_t record[STATE_RECORD_SIZE];
+
+// raw struct layout 0x0100 of earlier firmware as written to EEPROM
+static uint16_t legacyRecord(uint8_t* data) {
+    memset(data, 0, 172);
+    data[2] = 0x00;
+    data[3] = 0x01;
+    data[4] = 80;           // brightness
+    data[5] = 3;            // hours offset
+    data[6] = 1;            // daylight
+    data[7] = 1;            // NTP enabled
+    strcpy((char*)data + 76, "pool.test");
+    const uint16_t crc = Checksum::crc16(data + 2, 170);
+    data[0] = crc & 0xFF;
+    data[1] = crc >> 8;
+    return 172;
+}
+
+void setUp() {
+    host::flash.restore();
+    host::flash.erase(CONFIG_STORE_SECTOR_A);
+    host::flash.erase(CONFIG_STORE_SECTOR_B);
+    memset(EEPROM.getDataPtr(), 0xFF, SPI_FLASH_SEC_SIZE);
+}
+
+void tearDown() {
+}
+
+void test_tagged_round_trip() {
+    Configuration stored;
+    stored.loadDefaults();
+    stored.displayBrightness = 7;
+    stored.displayColors[3] = 0x123456;
+    strcpy(stored.timezone, "CET-1CEST,M3.5.0,M10.5.0/3");
+    const uint16_t length = stored.serialize(record, sizeof(record));
+    TEST_ASSERT_GREATER_THAN(0, length);
+
+    Configuration loaded;
+    loaded.loadDefaults();
+    TEST_ASSERT_TRUE(loaded.deserialize(record, length));
+    TEST_ASSERT_EQUAL_MEMORY(&stored, &loaded, sizeof(Configuration));
+}
+
+// tags of newer firmware are skipped, options missing in record keep defaults
+void test_unknown_and_missing_tags() {
+    const uint8_t data[] = { 0, 0, STATE_FORMAT_VERSION & 0xFF, STATE_FORMAT_VERSION >> 8,
+        200, 3, 'x', 'y', 'z', TAG_BRIGHTNESS, 1, 9 };
+    Configuration loaded;
+    loaded.loadDefaults();
+    TEST_ASSERT_TRUE(loaded.deserialize(data, sizeof(data)));
+    TEST_ASSERT_EQUAL(9, loaded.displayBrightness);
+    TEST_ASSERT_EQUAL_STRING("0.pool.ntp.org", loaded.timeServer1);
+    TEST_ASSERT_EQUAL(COLOR_MINUTES, loaded.displayColors[3]);
+}
+
+void test_legacy_layout_is_migrated() {
+    Configuration loaded;
+    loaded.loadDefaults();
+    const uint16_t length = legacyRecord(record);
+    TEST_ASSERT_FALSE(loaded.deserialize(record, length));
+    TEST_ASSERT_TRUE(loaded.migrate(record, length));
+    TEST_ASSERT_EQUAL(AutoBrightness::fromLinear(80), loaded.displayBrightness);
+    TEST_ASSERT_EQUAL_STRING("pool.test", loaded.timeServer1);
+    TEST_ASSERT_EQUAL_STRING("<+04>-4", loaded.timezone);
+
+    record[100] ^= 1;
+    TEST_ASSERT_FALSE(loaded.migrate(record, length));
+}
+
+// single-slot EEPROM layout is read until store has its first record
+void test_legacy_eeprom_is_read_until_first_record() {
+    legacyRecord(EEPROM.getDataPtr());
+    Configuration loaded;
+    TEST_ASSERT_TRUE(loaded.loadStoredConfigurationOrDefaults());
+    TEST_ASSERT_EQUAL(AutoBrightness::fromLinear(80), loaded.displayBrightness);
+
+    loaded.displayBrightness = 81;
+    TEST_ASSERT_TRUE(loaded.saveToStore());
+    Configuration reloaded;
+    TEST_ASSERT_TRUE(reloaded.loadStoredConfigurationOrDefaults());
+    TEST_ASSERT_EQUAL(81, reloaded.displayBrightness);
+    TEST_ASSERT_EQUAL_STRING("<+04>-4", reloaded.timezone);
+}
+
+// linear brightness of records written before gamma correction keeps its duty
+void test_linear_brightness_is_converted() {
+    const uint8_t data[] = { 0, 0, STATE_FORMAT_VERSION & 0xFF, STATE_FORMAT_VERSION >> 8,
+        TAG_LEGACY_BRIGHTNESS, 1, 50 };
+    Configuration loaded;
+    loaded.loadDefaults();
+    TEST_ASSERT_TRUE(loaded.deserialize(data, sizeof(data)));
+    TEST_ASSERT_INT_WITHIN(1, 122, loaded.displayBrightness);
+    TEST_ASSERT_INT_WITHIN(300, 50 * 257, AutoBrightness::scale(1, loaded.displayBrightness));
+    TEST_ASSERT_EQUAL(0, AutoBrightness::fromLinear(0));
+    TEST_ASSERT_EQUAL(255, AutoBrightness::fromLinear(255));
+
+    // converted level is written under new tag only
+    const uint16_t length = loaded.serialize(record, sizeof(record));
+    Configuration reloaded;
+    reloaded.loadDefaults();
+    reloaded.displayBrightness = 0;
+    TEST_ASSERT_TRUE(reloaded.deserialize(record, length));
+    TEST_ASSERT_EQUAL(loaded.displayBrightness, reloaded.displayBrightness);
+    for (uint16_t i = 4; i < length; i += 2 + record[i + 1]) {
+        TEST_ASSERT_NOT_EQUAL(TAG_LEGACY_BRIGHTNESS, record[i]);
+    }
+}
+
+void test_drift_save_keeps_other_changes_unsaved() {
+    Configuration stored;
+    TEST_ASSERT_FALSE(stored.loadStoredConfigurationOrDefaults());
+    stored.displayBrightness = 7;
+    TEST_ASSERT_TRUE(stored.saveToStore());
+
+    Configuration live;
+    live.loadStoredConfigurationOrDefaults();
+    live.displayBrightness = 99;
+    strcpy(live.timeServer1, "unsaved.test");
+    TEST_ASSERT_TRUE(live.saveClockDrift(-20000));
+    TEST_ASSERT_EQUAL(-20000, live.clockDrift);
+    TEST_ASSERT_EQUAL(99, live.displayBrightness);
+
+    Configuration loaded;
+    TEST_ASSERT_TRUE(loaded.loadStoredConfigurationOrDefaults());
+    TEST_ASSERT_EQUAL(-20000, loaded.clockDrift);
+    TEST_ASSERT_EQUAL(7, loaded.displayBrightness);
+    TEST_ASSERT_EQUAL_STRING("0.pool.ntp.org", loaded.timeServer1);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_tagged_round_trip);
+    RUN_TEST(test_unknown_and_missing_tags);
+    RUN_TEST(test_legacy_layout_is_migrated);
+    RUN_TEST(test_legacy_eeprom_is_read_until_first_record);
+    RUN_TEST(test_linear_brightness_is_converted);
+    RUN_TEST(test_drift_save_keeps_other_changes_unsaved);
+    return UNITY_END();
+}
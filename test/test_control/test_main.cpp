@@ -0,0 +1,275 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <memory>
+#include "control.h"
+
+#define KEY "0123456789abcdef"
+#define CLOCKS 3
+#define CONTROLLER_PORT 7000
+
+// fleet of clocks on loopback segment, each runs its own ControlServer
+struct Clock {
+    size_t node;
+    WiFiUDP udp;
+    ControlServer server;
+    uint8_t brightness;
+
+    Clock(size_t index) : node(index), udp(), server(udp), brightness(0) {
+    }
+};
+
+static std::vector<std::unique_ptr<Clock>> clocks;
+static size_t controller;
+static WiFiUDP controllerUdp;
+static br_hmac_key_context key;
+static uint32_t sequence;
+
+static bool handle(Clock& clock, const ControlCommand& command, ControlWriter& reply) {
+    switch (command.op) {
+        case CONTROL_SET_BRIGHTNESS:
+            clock.brightness = command.u8(0);
+            return true;
+        case CONTROL_SET_TIME: {
+            const timeval tv = { (time_t)command.u32(0), (suseconds_t)command.u32(4) };
+            return settimeofday(&tv, NULL) == 0;
+        }
+        case CONTROL_QUERY:
+            reply.command(CONTROL_STATE, 39);
+            for (uint8_t i = 0; i < 39; i++) {
+                reply.u8(clock.brightness);
+            }
+            return true;
+    }
+    return false;
+}
+
+// restart clock firmware after reset, RTC memory survives
+static void boot(Clock& clock) {
+    host::select(clock.node);
+    clock.server = ControlServer(clock.udp);
+    clock.server.begin(KEY, [&clock](const ControlCommand& command, ControlWriter& reply) {
+        return handle(clock, command, reply);
+    });
+    host::select(0);
+}
+
+// run loops of all clocks
+static void run(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        for (auto& clock : clocks) {
+            host::select(clock->node);
+            clock->server.poll(true);
+        }
+        host::select(0);
+        host::advance(1000);
+    }
+}
+
+static std::vector<uint8_t> packet(uint32_t target, uint8_t brightness, uint8_t queries = 0,
+        uint8_t flags = 0, int64_t skew = 0) {
+    uint8_t buf[CONTROL_PACKET_MAX];
+    host::select(controller);
+    ControlWriter writer(buf, sizeof(buf), flags, ++sequence, time(NULL) + skew, target);
+    writer.command(CONTROL_SET_BRIGHTNESS, 1).u8(brightness);
+    for (uint8_t i = 0; i < queries; i++) {
+        writer.command(CONTROL_QUERY, 0);
+    }
+    const size_t len = writer.finish(key);
+    host::select(0);
+    return std::vector<uint8_t>(buf, buf + len);
+}
+
+static void send(const std::vector<uint8_t>& data, IPAddress to = CONTROL_MULTICAST_IP) {
+    host::select(controller);
+    controllerUdp.beginPacket(to, CONTROL_PORT);
+    controllerUdp.write(data.data(), data.size());
+    controllerUdp.endPacket();
+    host::select(0);
+    run(5);
+}
+
+void setUp() {
+    if (clocks.empty()) {
+        ControlServer::initKey(key, KEY);
+        clocks.emplace_back(new Clock(0));
+        for (uint8_t i = 1; i < CLOCKS; i++) {
+            clocks.emplace_back(new Clock(host::addNode(100 + i, 0xC10C00 + i)));
+        }
+        controller = host::addNode(10, 0xC0DE);
+        host::select(controller);
+        controllerUdp.begin(CONTROLLER_PORT);
+        host::select(0);
+    }
+    for (auto& clock : clocks) {
+        host::select(clock->node);
+        host::powerCycle();
+        host::setWallClock(host::now);
+        clock->brightness = 0;
+        boot(*clock);
+    }
+    host::select(controller);
+    host::setWallClock(host::now);
+    host::select(0);
+    while (controllerUdp.parsePacket()) {
+    }
+    run(1);     // join multicast group
+}
+
+void tearDown() {
+}
+
+void test_batch_reaches_every_clock() {
+    send(packet(0, 42));
+    for (auto& clock : clocks) {
+        TEST_ASSERT_EQUAL(42, clock->brightness);
+        TEST_ASSERT_EQUAL(1, clock->server.getAccepted());
+    }
+}
+
+void test_targeted_packet_applies_on_one_clock() {
+    send(packet(0xC10C02, 7));
+    TEST_ASSERT_EQUAL(0, clocks[0]->brightness);
+    TEST_ASSERT_EQUAL(0, clocks[1]->brightness);
+    TEST_ASSERT_EQUAL(7, clocks[2]->brightness);
+}
+
+void test_wrong_key_rejected() {
+    std::vector<uint8_t> data = packet(0, 9);
+    data[data.size() - 1] ^= 1;
+    send(data);
+    for (auto& clock : clocks) {
+        TEST_ASSERT_EQUAL(0, clock->brightness);
+        TEST_ASSERT_EQUAL(1, clock->server.getRejected());
+    }
+}
+
+void test_replay_rejected_after_reset() {
+    const std::vector<uint8_t> data = packet(0, 11);
+    send(data);
+    for (auto& clock : clocks) {
+        host::select(clock->node);
+        host::reset();
+        host::setWallClock(host::now);
+        clock->brightness = 0;
+        boot(*clock);
+    }
+    run(1);
+    send(data);
+    for (auto& clock : clocks) {
+        TEST_ASSERT_EQUAL(0, clock->brightness);
+        TEST_ASSERT_EQUAL(1, clock->server.getRejected());
+    }
+    send(packet(0, 12));
+    TEST_ASSERT_EQUAL(12, clocks[1]->brightness);
+}
+
+void test_replay_rejected_after_power_loss_once_time_is_valid() {
+    const std::vector<uint8_t> data = packet(0, 13);
+    send(data);
+    host::advance((CONTROL_TIME_WINDOW_S + 60) * 1000000LL);
+    for (auto& clock : clocks) {
+        host::select(clock->node);
+        host::powerCycle();
+        host::setWallClock(host::now);  // synchronized by NTP again
+        clock->brightness = 0;
+        boot(*clock);
+    }
+    run(1);
+    send(data);
+    for (auto& clock : clocks) {
+        TEST_ASSERT_EQUAL(0, clock->brightness);
+    }
+}
+
+void test_clock_without_valid_time_accepts_time_setting() {
+    host::select(clocks[1]->node);
+    host::powerCycle();
+    TEST_ASSERT_LESS_THAN(TIME_VALID_SINCE, time(NULL));
+    boot(*clocks[1]);
+    run(1);
+
+    uint8_t buf[CONTROL_PACKET_MAX];
+    host::select(controller);
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    ControlWriter writer(buf, sizeof(buf), 0, ++sequence, tv.tv_sec, 0xC10C01);
+    writer.command(CONTROL_SET_TIME, 8).u32(tv.tv_sec).u32(tv.tv_usec);
+    send(std::vector<uint8_t>(buf, buf + writer.finish(key)));
+
+    host::select(clocks[1]->node);
+    TEST_ASSERT_INT64_WITHIN(10000, host::now, host::wallClock());
+    host::select(0);
+}
+
+void test_stale_packet_rejected() {
+    send(packet(0, 14, 0, 0, -CONTROL_TIME_WINDOW_S - 10));
+    for (auto& clock : clocks) {
+        TEST_ASSERT_EQUAL(0, clock->brightness);
+    }
+}
+
+void test_reply_reports_truncated_commands() {
+    send(packet(0xC10C01, 15, 3, CONTROL_FLAG_ACK));
+    host::select(controller);
+    const int size = controllerUdp.parsePacket();
+    TEST_ASSERT_GREATER_THAN(CONTROL_HEADER_SIZE + CONTROL_MAC_SIZE, size);
+    uint8_t reply[CONTROL_REPLY_MAX];
+    controllerUdp.read(reply, size);
+    host::select(0);
+
+    uint8_t mac[CONTROL_MAC_SIZE];
+    ControlServer::mac(key, reply, size - CONTROL_MAC_SIZE, mac);
+    TEST_ASSERT_EQUAL_MEMORY(mac, reply + size - CONTROL_MAC_SIZE, CONTROL_MAC_SIZE);
+    TEST_ASSERT_EQUAL(CONTROL_FLAG_REPLY, reply[3]);
+
+    // two state replies fit, third query is left out and reported
+    uint8_t states = 0;
+    size_t at = CONTROL_HEADER_SIZE;
+    while (reply[at] == CONTROL_STATE) {
+        states++;
+        at += 2 + reply[at + 1];
+    }
+    TEST_ASSERT_EQUAL(2, states);
+    TEST_ASSERT_EQUAL_HEX8(CONTROL_RESULT, reply[at]);
+    TEST_ASSERT_EQUAL(9, reply[at + 1]);
+    const ControlCommand result = { reply[at], reply[at + 1], reply + at + 2 };
+    TEST_ASSERT_EQUAL(4, result.u8(0));
+    TEST_ASSERT_EQUAL_HEX32(0, result.u32(1));
+    TEST_ASSERT_EQUAL_HEX32(1 << 3, result.u32(5));
+    TEST_ASSERT_EQUAL(at + 2 + 9 + CONTROL_MAC_SIZE, (size_t)size);
+}
+
+// multicast membership is bound to station address, reconnect with new address
+// joins group again
+void test_group_is_joined_again_after_reconnect() {
+    Clock& clock = *clocks[1];
+    host::select(clock.node);
+    const uint32_t ip = host::node().ip;
+    host::node().connected = false;
+    clock.server.poll(false);
+    host::node().ip = ip + (50 << 24);
+    host::node().connected = true;
+    host::select(0);
+    run(1);
+
+    send(packet(0, 42));
+    host::select(clock.node);
+    host::node().ip = ip;
+    host::select(0);
+    TEST_ASSERT_EQUAL(42, clock.brightness);
+    TEST_ASSERT_EQUAL(1, clock.server.getAccepted());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_batch_reaches_every_clock);
+    RUN_TEST(test_targeted_packet_applies_on_one_clock);
+    RUN_TEST(test_wrong_key_rejected);
+    RUN_TEST(test_replay_rejected_after_reset);
+    RUN_TEST(test_replay_rejected_after_power_loss_once_time_is_valid);
+    RUN_TEST(test_clock_without_valid_time_accepts_time_setting);
+    RUN_TEST(test_stale_packet_rejected);
+    RUN_TEST(test_reply_reports_truncated_commands);
+    RUN_TEST(test_group_is_joined_again_after_reconnect);
+    return UNITY_END();
+}
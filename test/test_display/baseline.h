@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include "clockface.h"
+
+// Clock faces of ClockDisplay::stripUpdate as they were before faces were split out
+// of display.h, pixels go to frame instead of strip. stripUpdate__ and stripUpdate_
+// are variants that were kept commented out there.
+namespace baseline {
+
+const uint8_t LEDS_PER_MINUTE = LED_COUNT / 60;
+
+inline void stripUpdate(uint32_t* frame, const uint32_t* _colors, uint8_t hh, uint8_t mm, uint8_t ss) {
+    for(uint8_t i = 0; i < LED_COUNT; i++) {
+        if (_colors[IDC_SECONDS] && (ss == i / LEDS_PER_MINUTE)) { // draw second marker
+            frame[i] = _colors[IDC_SECONDS];
+        }
+        else if (mm == i / LEDS_PER_MINUTE && (ss % 2 == 0)) { // draw minute marker (even seconds only)
+            frame[i] = _colors[IDC_MINUTES];
+        } 
+        else if (((i % LEDS_PER_HOUR) || (ss % 2)) &&  // draw hour marker (on tick leds odd seconds only)
+                (12 - 1 + hh) % 12 == (LED_COUNT + i - 1 - mm * LEDS_PER_HOUR / 60) % LED_COUNT / LEDS_PER_HOUR) {
+            frame[i] = (hh < 6 || hh > 17)
+                ? _colors[IDC_HOURS_N]
+                : _colors[IDC_HOURS_D];
+        }
+        else if (i % LEDS_PER_HOUR) { // damp non-tick space
+            frame[i] = 0x000000;
+        }
+        else frame[i] = _colors[IDC_TICKS]; // draw ticks
+    }
+}
+
+// hours indication smooth steps
+inline void stripUpdate__(uint32_t* frame, const uint32_t* _colors, uint8_t hh, uint8_t mm, uint8_t ss) {
+    for(uint8_t i = 0; i < LED_COUNT; i++) {
+        if (_colors[IDC_SECONDS] && (ss == i / LEDS_PER_MINUTE)) {
+            frame[i] = _colors[IDC_SECONDS];
+        }
+        else if (mm == i / LEDS_PER_MINUTE) {
+            frame[i] = _colors[IDC_MINUTES];
+        }
+        else if (i % LEDS_PER_HOUR) {
+            if ((11 + hh) % 12 == (LED_COUNT + i - 1 - mm * LEDS_PER_HOUR / 60) % LED_COUNT / LEDS_PER_HOUR) {
+                frame[i] = (hh < 6 || hh > 17)
+                    ? _colors[IDC_HOURS_N]
+                    : _colors[IDC_HOURS_D];
+            }
+            else frame[i] = 0x000000;
+        }
+        else {
+            frame[i] = _colors[IDC_TICKS];
+        }
+    }
+}
+
+// hours indication rough steps after hour changes
+inline void stripUpdate_(uint32_t* frame, const uint32_t* _colors, uint8_t hh, uint8_t mm, uint8_t ss) {
+    for(uint8_t i = 0; i < LED_COUNT; i++) {
+        if (_colors[IDC_SECONDS] && (ss == i / LEDS_PER_MINUTE)) {
+            frame[i] = _colors[IDC_SECONDS];
+        }
+        else if (mm == i / LEDS_PER_MINUTE) {
+            frame[i] = _colors[IDC_MINUTES];
+        }
+        else if (i % LEDS_PER_HOUR) {
+            if ((hh % 12) == (i / LEDS_PER_HOUR)) {
+                frame[i] = (hh < 6 || hh > 17)
+                    ? _colors[IDC_HOURS_N]
+                    : _colors[IDC_HOURS_D];
+            }
+            else frame[i] = 0x000000;
+        }
+        else {
+            frame[i] = _colors[IDC_TICKS];
+        }
+    }
+}
+
+}
@@ -0,0 +1,204 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <math.h>
+#include "configuration.h"
+#include "display.h"
+#include "mytime.h"
+#include "baseline.h"
+
+#define MIDNIGHT 1700006400L    // 2023-11-15T00:00:00Z
+#define HALF_DAY 43200L
+
+static Configuration state;
+static ClockDisplay display;
+
+void setUp() {
+    NtpHelper::initializeTimezone("UTC0");
+    state.loadDefaults();
+    display.initialize(state.displayBrightness, state.displayColors);
+    display.setPowerBudget(0);
+    display.setFace(FACE_CLASSIC);
+}
+
+void tearDown() {
+}
+
+typedef void (*BaselineFace)(uint32_t* frame, const uint32_t* colors, uint8_t hh, uint8_t mm, uint8_t ss);
+
+// render every second of 12 hours from start and compare with baseline face
+static void sweep(time_t start, const uint32_t* colors, BaselineFace face = baseline::stripUpdate) {
+    uint32_t expected[LED_COUNT];
+    char message[32];
+    for (time_t t = start; t < start + HALF_DAY; t++) {
+        tm utc;
+        gmtime_r(&t, &utc);
+        display.stripUpdate(t);
+        face(expected, colors, utc.tm_hour, utc.tm_min, utc.tm_sec);
+        snprintf(message, sizeof(message), "%02d:%02d:%02d", utc.tm_hour, utc.tm_min, utc.tm_sec);
+        TEST_ASSERT_EQUAL_HEX32_ARRAY_MESSAGE(expected, display.getFrame(), LED_COUNT, message);
+    }
+}
+
+void test_frames_match_baseline_before_noon() {
+    sweep(MIDNIGHT, state.displayColors);
+}
+
+void test_frames_match_baseline_after_noon() {
+    sweep(MIDNIGHT + HALF_DAY, state.displayColors);
+}
+
+void test_frames_match_baseline_without_seconds_marker() {
+    uint32_t colors[5] = { COLOR_TICKS, COLOR_HOURS_N, COLOR_HOURS_D, COLOR_MINUTES, 0 };
+    display.setBrightnessAndColorScheme(state.displayBrightness, colors);
+    sweep(MIDNIGHT + HALF_DAY / 2, colors);
+}
+
+void test_stepped_face_matches_baseline() {
+    display.setFace(FACE_STEPPED);
+    sweep(MIDNIGHT, state.displayColors, baseline::stripUpdate__);
+}
+
+void test_rough_face_matches_baseline() {
+    display.setFace(FACE_ROUGH);
+    sweep(MIDNIGHT + HALF_DAY / 2, state.displayColors, baseline::stripUpdate_);
+}
+
+// largest per channel difference of two frames, pixels of minutes in skip are ignored
+static uint8_t frameDistance(const uint32_t* a, const uint32_t* b, std::initializer_list<uint8_t> skip = {}) {
+    uint8_t distance = 0;
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        if (std::find(skip.begin(), skip.end(), i * 60 / LED_COUNT) != skip.end()) {
+            continue;
+        }
+        for (uint8_t shift = 0; shift < 24; shift += 8) {
+            const int d = abs((int)((a[i] >> shift) & 0xFF) - (int)((b[i] >> shift) & 0xFF));
+            distance = max(distance, (uint8_t)d);
+        }
+    }
+    return distance;
+}
+
+// animated classic face over 12 hours: last fraction of every second flows into next
+// second without visible step (minute marker jumps on minute change and hour color
+// on day and night switch by design, same hour colors are used), and frames where
+// hour hand sits exactly on pixel boundary equal static face
+void test_classic_smooth_sweep_is_continuous() {
+    uint32_t colors[5];
+    memcpy(colors, state.displayColors, sizeof(colors));
+    colors[IDC_HOURS_D] = colors[IDC_HOURS_N];
+    uint32_t last[LED_COUNT], first[LED_COUNT], still[LED_COUNT];
+    char message[32];
+    for (uint32_t s = 0; s < HALF_DAY; s++) {
+        const uint8_t hh = s / 3600, mm = s / 60 % 60, ss = s % 60;
+        const uint32_t n = (s + 1) % HALF_DAY;
+        const uint8_t nh = n / 3600, nm = n / 60 % 60, ns = n % 60;
+        snprintf(message, sizeof(message), "%02u:%02u:%02u", hh, mm, ss);
+
+        ClassicFace::renderSmooth(last, colors, hh, mm, ss, 255);
+        ClassicFace::renderSmooth(first, colors, nh, nm, ns, 0);
+        const uint8_t distance = nm == mm ? frameDistance(last, first) : frameDistance(last, first, { mm, nm });
+        TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(2, distance, message);
+
+        if (mm % 12 == 0 && ss == 0) {
+            ClassicFace::renderSmooth(first, colors, hh, mm, ss, 0);
+            ClassicFace::render(still, colors, hh, mm, ss);
+            TEST_ASSERT_EQUAL_HEX32_ARRAY_MESSAGE(still, first, LED_COUNT, message);
+        }
+    }
+}
+
+void test_unchanged_frame_skips_strip_update() {
+    display.poll(); // applies brightness level
+    display.stripUpdate(MIDNIGHT);
+    TEST_ASSERT_GREATER_THAN(0, display.getChangedPixels());
+    display.stripUpdate(MIDNIGHT);
+    TEST_ASSERT_EQUAL(0, display.getChangedPixels());
+}
+
+// leaving animation mode within second redraws static face right away
+void test_static_face_is_redrawn_after_animation() {
+    uint32_t expected[LED_COUNT];
+    ClassicFace::render(expected, state.displayColors, 0, 0, 0);
+    host::setWallClock(MIDNIGHT * 1000000LL + 100000);
+    display.poll();
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected, display.getFrame(), LED_COUNT);
+
+    TEST_ASSERT_TRUE(display.setFps(25));
+    host::advance(500000);
+    display.poll();
+    TEST_ASSERT_FALSE(memcmp(expected, display.getFrame(), sizeof(expected)) == 0);
+
+    TEST_ASSERT_TRUE(display.setFps(0));
+    display.poll();
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected, display.getFrame(), LED_COUNT);
+    TEST_ASSERT_GREATER_THAN(0, display.getChangedPixels());
+}
+
+void test_gamma_table_follows_curve() {
+    for (uint16_t level = 1; level < 256; level++) {
+        const double expected = pow(level / 255.0, GAMMA_RED) * 65535;
+        TEST_ASSERT_TRUE(fabs(AutoBrightness::scale(0, level) - expected) <= 1.0 || AutoBrightness::scale(0, level) == 1);
+        TEST_ASSERT_GREATER_OR_EQUAL(AutoBrightness::scale(0, level - 1), AutoBrightness::scale(0, level));
+    }
+    TEST_ASSERT_EQUAL(0, AutoBrightness::scale(2, 0));
+    TEST_ASSERT_EQUAL(65535, AutoBrightness::scale(2, 255));
+}
+
+void test_sensor_brightness_fades_to_mapped_level() {
+    AutoBrightness brightness;
+    TEST_ASSERT_FALSE(brightness.configure(BRIGHTNESS_SENSOR, 10, 500, 500));
+    TEST_ASSERT_TRUE(brightness.configure(BRIGHTNESS_SENSOR, 10, 100, 900));
+    host::analog = 500;     // halfway between dark and bright
+    uint8_t level = 0, previous = 0;
+    for (uint8_t poll = 0; poll < 100; poll++) {
+        level = brightness.update(210, 12);
+        TEST_ASSERT_GREATER_OR_EQUAL(previous, level);
+        TEST_ASSERT_LESS_OR_EQUAL(previous + 14, level);     // fades in steps of 1/8
+        previous = level;
+    }
+    TEST_ASSERT_EQUAL(110, level);
+    TEST_ASSERT_EQUAL(500, brightness.getAmbient());
+    host::analog = 0;
+}
+
+void test_power_budget_below_idle_current_rejected() {
+    TEST_ASSERT_FALSE(display.setPowerBudget(60));
+    TEST_ASSERT_FALSE(ClockDisplay::isValidPowerBudget(-1));
+    TEST_ASSERT_FALSE(ClockDisplay::isValidPowerBudget(0x10000));
+    TEST_ASSERT_EQUAL(0, display.getPowerBudget());
+    TEST_ASSERT_TRUE(display.setPowerBudget(61));
+    TEST_ASSERT_TRUE(display.setPowerBudget(0));
+}
+
+void test_power_limit_scales_frame_to_budget() {
+    display.poll();
+    TEST_ASSERT_TRUE(display.setPowerBudget(100));
+    display.stripUpdate(MIDNIGHT);
+    TEST_ASSERT_LESS_OR_EQUAL(100, display.getCurrent());
+    TEST_ASSERT_GREATER_THAN(0, display.getLimitedFrames());
+}
+
+void test_time_string_round_trip() {
+    const Time parsed("20231115T123456Z");
+    TEST_ASSERT_EQUAL(MIDNIGHT + 12 * 3600 + 34 * 60 + 56, parsed.milliseconds());
+    TEST_ASSERT_EQUAL_STRING("20231115T123456Z", parsed.toString().c_str());
+    TEST_ASSERT_EQUAL(NOT_A_TIME, Time("2023-11-15 12:34").milliseconds());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_frames_match_baseline_before_noon);
+    RUN_TEST(test_frames_match_baseline_after_noon);
+    RUN_TEST(test_frames_match_baseline_without_seconds_marker);
+    RUN_TEST(test_stepped_face_matches_baseline);
+    RUN_TEST(test_rough_face_matches_baseline);
+    RUN_TEST(test_classic_smooth_sweep_is_continuous);
+    RUN_TEST(test_unchanged_frame_skips_strip_update);
+    RUN_TEST(test_static_face_is_redrawn_after_animation);
+    RUN_TEST(test_gamma_table_follows_curve);
+    RUN_TEST(test_sensor_brightness_fades_to_mapped_level);
+    RUN_TEST(test_power_budget_below_idle_current_rejected);
+    RUN_TEST(test_power_limit_scales_frame_to_budget);
+    RUN_TEST(test_time_string_round_trip);
+    return UNITY_END();
+}
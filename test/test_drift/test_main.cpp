@@ -0,0 +1,93 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "drift.h"
+
+#define FAST_PPB 20000          // node oscillator runs 20 ppm fast
+#define NTP_POLL_S 64
+
+static DriftCompensation* drift;
+
+// system clock minus true time, us
+static int64_t error() {
+    return host::wallClock() - host::now;
+}
+
+// run loop() for given seconds, NTP corrects system clock every NTP_POLL_S when enabled
+static void run(uint32_t seconds, bool ntp) {
+    for (uint32_t s = 1; s <= seconds; s++) {
+        host::advance(1000000);
+        drift->poll();
+        if (ntp && s % NTP_POLL_S == 0) {
+            const int64_t offset = -error();
+            host::setWallClock(host::now);
+            drift->sample(offset);
+        }
+    }
+}
+
+void setUp() {
+    host::select(0);
+    host::powerCycle();
+    host::node().driftPpb = FAST_PPB;
+    host::setWallClock(host::now);
+    drift = new DriftCompensation();
+}
+
+void tearDown() {
+    delete drift;
+    host::node().driftPpb = 0;
+}
+
+void test_learns_oscillator_error_from_corrections() {
+    TEST_ASSERT_FALSE(drift->begin(0));
+    run(DRIFT_MIN_SPAN_S + 600, true);
+    TEST_ASSERT_INT_WITHIN(200, -FAST_PPB, drift->getDrift());
+    TEST_ASSERT_GREATER_OR_EQUAL(DRIFT_MIN_SPAN_S, drift->getSpan());
+
+    // one hour without network, uncompensated clock would be 72 ms ahead
+    run(3600, false);
+    TEST_ASSERT_INT_WITHIN(5000, 0, error());
+}
+
+void test_large_correction_restarts_span() {
+    drift->begin(0);
+    run(DRIFT_MIN_SPAN_S / 2, true);
+    TEST_ASSERT_GREATER_THAN(0, drift->getSpan());
+    host::advance(1000000);
+    drift->sample(DRIFT_STEP_US + 1);
+    TEST_ASSERT_EQUAL(0, drift->getSpan());
+    host::advance(1000000);
+    drift->sample(1000);
+    TEST_ASSERT_EQUAL(1, drift->getSpan());
+    host::advance(1000000);
+    drift->sample(0, true);
+    TEST_ASSERT_EQUAL(0, drift->getSpan());
+    drift->restart();
+    TEST_ASSERT_EQUAL(0, drift->getSpan());
+}
+
+void test_time_survives_reset_but_not_power_loss() {
+    drift->begin(-FAST_PPB);
+    run(10, false);
+    host::advance(3000000);
+    host::reset();
+    TEST_ASSERT_LESS_THAN(TIME_VALID_SINCE, time(NULL));
+
+    DriftCompensation restarted;
+    TEST_ASSERT_TRUE(restarted.begin(-FAST_PPB));
+    TEST_ASSERT_TRUE(restarted.isRestored());
+    TEST_ASSERT_INT_WITHIN(1000, 0, error());
+
+    host::powerCycle();
+    DriftCompensation cold;
+    TEST_ASSERT_FALSE(cold.begin(-FAST_PPB));
+    TEST_ASSERT_LESS_THAN(TIME_VALID_SINCE, time(NULL));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_learns_oscillator_error_from_corrections);
+    RUN_TEST(test_large_correction_restarts_span);
+    RUN_TEST(test_time_survives_reset_but_not_power_loss);
+    return UNITY_END();
+}
@@ -0,0 +1,131 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <ESP8266WiFi.h>
+#include "events.h"
+
+#define SNAPSHOT "{\"ntpsynced\":false}"
+
+static HttpServer* server;
+static EventStream* events;
+
+static size_t snapshot(char* buf, size_t size) {
+    return snprintf(buf, size, SNAPSHOT);
+}
+
+// GET /events on new connection
+static std::shared_ptr<WiFiClient::Connection> request() {
+    auto connection = std::make_shared<WiFiClient::Connection>();
+    TEST_ASSERT_TRUE(server->backend().request(HTTP_GET, "/events", {}, WiFiClient(connection)));
+    return connection;
+}
+
+// subscriber with response headers and status snapshot already read
+static std::shared_ptr<WiFiClient::Connection> connect() {
+    auto connection = request();
+    TEST_ASSERT_TRUE(connection->connected);
+    connection->received.clear();
+    return connection;
+}
+
+void setUp() {
+    server = new HttpServer(80);
+    events = new EventStream();
+    events->begin(*server, "/events", snapshot);
+}
+
+void tearDown() {
+    delete events;
+    delete server;
+}
+
+void test_subscriber_gets_headers_and_snapshot() {
+    auto connection = request();
+    TEST_ASSERT_TRUE(connection->noDelay);
+    const std::string& received = connection->received;
+    TEST_ASSERT_EQUAL(0, received.find("HTTP/1.1 200 OK\r\n"));
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, received.find("Content-Type: text/event-stream\r\n"));
+    const size_t body = received.find("\r\n\r\n") + 4;
+    TEST_ASSERT_EQUAL_STRING("event: status\ndata: " SNAPSHOT "\n\n", received.c_str() + body);
+    TEST_ASSERT_EQUAL(1, events->subscribers());
+}
+
+void test_event_framing() {
+    auto first = connect();
+    auto second = request();
+    events->publish("time", "20231115T000000Z");
+    TEST_ASSERT_EQUAL_STRING("event: time\ndata: 20231115T000000Z\n\n", first->received.c_str());
+    const std::string& received = second->received;
+    TEST_ASSERT_EQUAL_STRING("event: status\ndata: " SNAPSHOT "\n\nevent: time\ndata: 20231115T000000Z\n\n",
+        received.c_str() + received.find("\r\n\r\n") + 4);
+}
+
+void test_unchanged_data_is_suppressed() {
+    auto connection = connect();
+    uint16_t prevSync = 0;
+    events->publishChanged("sync", "{\"ntpsynced\":true}", prevSync);
+    events->publishChanged("sync", "{\"ntpsynced\":true}", prevSync);
+    TEST_ASSERT_EQUAL_STRING("event: sync\ndata: {\"ntpsynced\":true}\n\n", connection->received.c_str());
+    connection->received.clear();
+    events->publishChanged("sync", "{\"ntpsynced\":false}", prevSync);
+    TEST_ASSERT_EQUAL_STRING("event: sync\ndata: {\"ntpsynced\":false}\n\n", connection->received.c_str());
+}
+
+void test_keepalive_is_comment_after_idle_period() {
+    auto connection = connect();
+    events->publish("time", "20231115T000000Z");
+    connection->received.clear();
+    host::advance((EVENT_KEEPALIVE_MS - 1) * 1000);
+    events->poll();
+    TEST_ASSERT_EQUAL_STRING("", connection->received.c_str());
+    host::advance(1000);
+    events->poll();
+    TEST_ASSERT_EQUAL_STRING(":\n\n", connection->received.c_str());
+}
+
+void test_slow_subscriber_is_skipped_then_dropped() {
+    auto slow = connect();
+    auto fast = connect();
+    slow->room = 10;
+    for (uint8_t i = 0; i < EVENT_MISSED_MAX - 1; i++) {
+        events->publish("time", "20231115T000000Z");
+    }
+    TEST_ASSERT_EQUAL_STRING("", slow->received.c_str());
+    TEST_ASSERT_TRUE(slow->connected);
+    slow->room = 5744;
+    events->publish("time", "20231115T000001Z");
+    TEST_ASSERT_EQUAL_STRING("event: time\ndata: 20231115T000001Z\n\n", slow->received.c_str());
+
+    slow->room = 10;
+    for (uint8_t i = 0; i < EVENT_MISSED_MAX; i++) {
+        events->publish("time", "20231115T000002Z");
+    }
+    TEST_ASSERT_FALSE(slow->connected);
+    TEST_ASSERT_EQUAL(1, events->subscribers());
+    // three lines per event, fast subscriber got every one
+    TEST_ASSERT_EQUAL(2 * EVENT_MISSED_MAX * 3, std::count(fast->received.begin(), fast->received.end(), '\n'));
+}
+
+void test_subscribers_are_limited() {
+    std::shared_ptr<WiFiClient::Connection> connections[EVENT_CLIENTS_MAX];
+    for (uint8_t i = 0; i < EVENT_CLIENTS_MAX; i++) {
+        connections[i] = connect();
+    }
+    auto refused = request();
+    TEST_ASSERT_EQUAL(503, server->backend().response.code);
+    TEST_ASSERT_EQUAL_STRING("", refused->received.c_str());
+    connections[3]->connected = false;
+    auto accepted = request();
+    TEST_ASSERT_EQUAL(0, server->backend().response.code);
+    TEST_ASSERT_EQUAL(EVENT_CLIENTS_MAX, events->subscribers());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_subscriber_gets_headers_and_snapshot);
+    RUN_TEST(test_event_framing);
+    RUN_TEST(test_unchanged_data_is_suppressed);
+    RUN_TEST(test_keepalive_is_comment_after_idle_period);
+    RUN_TEST(test_slow_subscriber_is_skipped_then_dropped);
+    RUN_TEST(test_subscribers_are_limited);
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "metrics.h"
+#include "webserver.h"
+
+static HttpServer* server;
+
+void setUp() {
+    server = new HttpServer(80);
+}
+
+void tearDown() {
+    delete server;
+}
+
+// sample value of metric line in Prometheus text, -1 when line is missing
+static long sample(const std::string& text, const std::string& metric) {
+    const size_t found = text.find(metric + " ");
+    if (found == std::string::npos || (found && text[found - 1] != '\n')) {
+        return -1;
+    }
+    return atol(text.c_str() + found + metric.length() + 1);
+}
+
+void test_histogram_buckets_are_cumulative_powers_of_two() {
+    Histogram histogram;
+    histogram.record(0);
+    histogram.record(32);       // first bucket includes its upper bound
+    histogram.record(33);
+    histogram.record(1000);
+    histogram.record(10000000); // overflow bucket
+    char buf[2048];
+    BufferWriter out(buf, sizeof(buf));
+    histogram.write(out, "t");
+    TEST_ASSERT_FALSE(out.overflow());
+    const std::string text(buf, out.length());
+    TEST_ASSERT_EQUAL(2, sample(text, "t_bucket{le=\"0.000032\"}"));
+    TEST_ASSERT_EQUAL(3, sample(text, "t_bucket{le=\"0.000064\"}"));
+    TEST_ASSERT_EQUAL(3, sample(text, "t_bucket{le=\"0.000512\"}"));
+    TEST_ASSERT_EQUAL(4, sample(text, "t_bucket{le=\"0.001024\"}"));
+    TEST_ASSERT_EQUAL(4, sample(text, "t_bucket{le=\"0.131072\"}"));
+    TEST_ASSERT_EQUAL(5, sample(text, "t_bucket{le=\"+Inf\"}"));
+    TEST_ASSERT_EQUAL(5, sample(text, "t_count"));
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, text.find("\nt_sum 10.001065\n"));
+}
+
+void test_histogram_labels() {
+    Histogram histogram;
+    histogram.record(100);
+    char buf[2048];
+    BufferWriter out(buf, sizeof(buf));
+    histogram.write(out, "h", "route=\"/status\"");
+    const std::string text(buf, out.length());
+    TEST_ASSERT_EQUAL(1, sample(text, "h_bucket{route=\"/status\",le=\"+Inf\"}"));
+    TEST_ASSERT_EQUAL(1, sample(text, "h_count{route=\"/status\"}"));
+}
+
+void test_parts_are_sent_as_chunks() {
+    server->on("/metrics", HTTP_GET, [](HttpRequest& request) {
+        request.sendParts(200, "text/plain", [](uint16_t part, BufferWriter& out) {
+            if (part == 3) {
+                return false;
+            }
+            out.printf("part %u\n", part);
+            return true;
+        });
+    });
+    ESP8266WebServer& backend = server->backend();
+    TEST_ASSERT_TRUE(backend.request(HTTP_GET, "/metrics"));
+    TEST_ASSERT_EQUAL(200, backend.response.code);
+    TEST_ASSERT_EQUAL_STRING("part 0\npart 1\npart 2\n", backend.response.body.c_str());
+    TEST_ASSERT_EQUAL(4, backend.chunks);   // closing empty chunk
+}
+
+// part not fitting buffer closes connection before closing chunk, client sees
+// failed response instead of truncated one
+void test_overflowing_part_aborts_response() {
+    server->on("/metrics", HTTP_GET, [](HttpRequest& request) {
+        request.sendParts(200, "text/plain", [](uint16_t part, BufferWriter& out) {
+            for (uint16_t i = 0; i < (part == 1 ? WEB_PART_SIZE : 1); i++) {
+                out.write("x");
+            }
+            return part < 3;
+        });
+    });
+    ESP8266WebServer& backend = server->backend();
+    auto connection = std::make_shared<WiFiClient::Connection>();
+    TEST_ASSERT_TRUE(backend.request(HTTP_GET, "/metrics", {}, WiFiClient(connection)));
+    TEST_ASSERT_EQUAL_STRING("x", backend.response.body.c_str());
+    TEST_ASSERT_EQUAL(1, backend.chunks);
+    TEST_ASSERT_FALSE(connection->connected);
+}
+
+void test_route_latency_is_recorded() {
+    server->on("/slow", HTTP_GET, [](HttpRequest& request) {
+        delay(3);
+        request.send(200, "text/plain", "ok");
+    });
+    TEST_ASSERT_TRUE(server->backend().request(HTTP_GET, "/slow"));
+    TEST_ASSERT_TRUE(server->backend().request(HTTP_GET, "/slow"));
+    TEST_ASSERT_EQUAL(1, server->routeCount());
+    const HttpServer::Route& route = server->route(0);
+    TEST_ASSERT_EQUAL_STRING("/slow", route.uri);
+    TEST_ASSERT_EQUAL_STRING("GET", route.method);
+    TEST_ASSERT_EQUAL(2, route.latency.count());
+
+    char buf[2048];
+    BufferWriter out(buf, sizeof(buf));
+    route.latency.write(out, "l");
+    const std::string text(buf, out.length());
+    TEST_ASSERT_EQUAL(0, sample(text, "l_bucket{le=\"0.002048\"}"));
+    TEST_ASSERT_EQUAL(2, sample(text, "l_bucket{le=\"0.004096\"}"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_histogram_buckets_are_cumulative_powers_of_two);
+    RUN_TEST(test_histogram_labels);
+    RUN_TEST(test_parts_are_sent_as_chunks);
+    RUN_TEST(test_overflowing_part_aborts_response);
+    RUN_TEST(test_route_latency_is_recorded);
+    return UNITY_END();
+}
@@ -0,0 +1,192 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <WiFiUdp.h>
+#include "ntp.h"
+
+#define SERVER_HOST 9
+#define SERVER_IP IPADDR4_INIT_BYTES(192, 168, 0, SERVER_HOST)
+#define SLOW_HOST 10                // answers late from clock 100 ms ahead
+#define SLOW_DELAY_US 40000
+#define SLOW_ERROR_US 100000
+
+static WiFiUDP udp;
+static Ntp ntp(udp);
+static host::Endpoint server, slow;
+static size_t serverNode, slowNode;
+
+static void writeTimestamp(uint8_t* p, int64_t us) {
+    const uint32_t seconds = us / 1000000 + SEVENZYYEARS;
+    const uint32_t fraction = ((uint64_t)(us % 1000000) << 32) / 1000000;
+    for (uint8_t i = 0; i < 4; i++) {
+        p[i] = seconds >> (24 - i * 8);
+        p[i + 4] = fraction >> (24 - i * 8);
+    }
+}
+
+// stratum 1 server answering from its own clock, which is true time
+static void answer(uint32_t from, uint16_t fromPort, const std::vector<uint8_t>& request) {
+    uint8_t response[NTP_PACKET_SIZE] = {};
+    response[0] = 0b00100100;   // LI 0, version 4, server mode
+    response[1] = 1;
+    memcpy(response + 24, request.data() + 40, 8);
+    writeTimestamp(response + 32, host::wallClock());
+    writeTimestamp(response + 40, host::wallClock());
+    host::sendto(NTP_SERVER_PORT, from, fromPort, response, sizeof(response));
+}
+
+// server that holds requests before answering, its receive and transmit stamps are
+// both taken when answering so waiting counts as network delay
+static void answerLate(uint32_t from, uint16_t fromPort, const std::vector<uint8_t>& request) {
+    host::schedule(SLOW_DELAY_US, slowNode, [from, fromPort, request] { answer(from, fromPort, request); });
+}
+
+// run client loop on node 0 for given time
+static void run(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        ntp.poll(true);
+        host::advance(1000);
+    }
+}
+
+void setUp() {
+    if (!serverNode) {
+        serverNode = host::addNode(SERVER_HOST, 0x5E7E9);
+        server = host::Endpoint{ serverNode, NTP_SERVER_PORT, 0, answer };
+        host::bind(&server);
+        slowNode = host::addNode(SLOW_HOST, 0x51D1);
+        slow = host::Endpoint{ slowNode, NTP_SERVER_PORT, 0, answerLate };
+        host::bind(&slow);
+    }
+    host::select(serverNode);
+    host::setWallClock(host::now);
+    host::select(slowNode);
+    host::setWallClock(host::now + SLOW_ERROR_US);
+    host::select(0);
+    host::setWallClock(host::now + 3000000);
+    WiFi.hosts.clear();
+}
+
+void tearDown() {
+}
+
+void test_lookup_does_not_hold_poll() {
+    WiFi.hosts["ntp.test"] = SERVER_IP;
+    ntp.begin("ntp.test", "", "");
+    const int64_t start = host::now;
+    ntp.poll(true);
+    TEST_ASSERT_EQUAL_INT64(start, host::now);
+    TEST_ASSERT_FALSE(ntp.isSyncronized());
+
+    // answer of lookup starts synchronization right away instead of after retry interval
+    run(host::dnsLatency / 1000 + 10);
+    TEST_ASSERT_TRUE(ntp.isSyncronized());
+    TEST_ASSERT_INT32_WITHIN(1000, -3000000, ntp.getLastOffset());
+    TEST_ASSERT_INT64_WITHIN(1000, host::now, host::wallClock());
+}
+
+void test_unknown_name_retries_later() {
+    ntp.begin("missing.test", "", "");
+    run(1000);
+    TEST_ASSERT_FALSE(ntp.isSyncronized());
+
+    WiFi.hosts["missing.test"] = SERVER_IP;
+    run(NTP_RETRY_INTERVAL_MS - 1000 + host::dnsLatency / 1000 + 10);
+    TEST_ASSERT_TRUE(ntp.isSyncronized());
+}
+
+void test_literal_address_needs_no_lookup() {
+    ntp.begin("192.168.0.9", "", "");
+    ntp.poll(true);
+    host::advance(1000);
+    ntp.poll(true);
+    TEST_ASSERT_TRUE(ntp.isSyncronized());
+}
+
+void test_answer_for_replaced_server_is_dropped() {
+    WiFi.hosts["old.test"] = IPADDR4_INIT_BYTES(192, 168, 0, 250);
+    WiFi.hosts["ntp.test"] = SERVER_IP;
+    ntp.begin("old.test", "", "");
+    ntp.poll(true);
+    ntp.begin("192.168.0.9", "", "");
+    run(host::dnsLatency / 1000 + 10);
+    TEST_ASSERT_TRUE(ntp.isSyncronized());
+    TEST_ASSERT_INT32_WITHIN(1000, -3000000, ntp.getLastOffset());
+}
+
+void test_smallest_delay_wins() {
+    ntp.begin("192.168.0.10", "192.168.0.9", "");
+    run(NTP_TIMEOUT_MS + 10);
+    TEST_ASSERT_TRUE(ntp.isSyncronized());
+    TEST_ASSERT_INT32_WITHIN(1000, -3000000, ntp.getLastOffset());
+    TEST_ASSERT_LESS_THAN(SLOW_DELAY_US, ntp.getLastDelay());
+}
+
+// small offset after first synchronization is slewed, system clock never moves by
+// more than slew rate per second and converges
+void test_small_offset_is_slewed() {
+    ntp.begin("192.168.0.9", "", "");
+    run(1000);
+    TEST_ASSERT_TRUE(ntp.isSyncronized());
+    host::setWallClock(host::wallClock() + 200000);
+    ntp.requestSync();
+    run(1000);
+    TEST_ASSERT_INT32_WITHIN(1000, -200000, ntp.getLastOffset());
+    TEST_ASSERT_INT64_WITHIN(1000, host::now + 200000, host::wallClock());
+
+    int64_t error = host::wallClock() - host::now;
+    for (uint16_t s = 0; s < 420; s++) {
+        run(1000);
+        const int64_t next = host::wallClock() - host::now;
+        TEST_ASSERT_TRUE(next <= error);
+        TEST_ASSERT_TRUE(error - next <= NTP_SLEW_PPM);
+        error = next;
+    }
+    TEST_ASSERT_INT64_WITHIN(1000, host::now, host::wallClock());
+    TEST_ASSERT_EQUAL(0, ntp.getPendingOffset());
+}
+
+// offsets beyond 32 bits of microseconds, like first step from 1970 or long
+// outage, are kept whole and flagged as steps
+void test_large_offset_is_stepped_whole() {
+    ntp.begin("192.168.0.9", "", "");
+    run(1000);
+    host::setWallClock(host::wallClock() - 3600000000LL);
+    ntp.requestSync();
+    run(1000);
+    TEST_ASSERT_TRUE(ntp.wasStepped());
+    TEST_ASSERT_INT64_WITHIN(1000, 3600000000LL, ntp.getLastOffset());
+    TEST_ASSERT_INT64_WITHIN(1000, host::now, host::wallClock());
+}
+
+// sample taken while previous one is still slewed holds its remainder again,
+// only new error counts as correction
+void test_correction_excludes_pending_slew() {
+    ntp.begin("192.168.0.9", "", "");
+    run(1000);
+    host::setWallClock(host::wallClock() + 400000);
+    ntp.requestSync();
+    run(1000);
+    TEST_ASSERT_FALSE(ntp.wasStepped());
+    TEST_ASSERT_INT64_WITHIN(1000, -400000, ntp.getLastCorrection());
+
+    run(100000);
+    host::setWallClock(host::wallClock() + 20000);
+    ntp.requestSync();
+    run(1000);
+    TEST_ASSERT_FALSE(ntp.wasStepped());
+    TEST_ASSERT_INT64_WITHIN(2000, -370000, ntp.getLastOffset());
+    TEST_ASSERT_INT64_WITHIN(1000, -20000, ntp.getLastCorrection());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_lookup_does_not_hold_poll);
+    RUN_TEST(test_unknown_name_retries_later);
+    RUN_TEST(test_literal_address_needs_no_lookup);
+    RUN_TEST(test_answer_for_replaced_server_is_dropped);
+    RUN_TEST(test_smallest_delay_wins);
+    RUN_TEST(test_small_offset_is_slewed);
+    RUN_TEST(test_large_offset_is_stepped_whole);
+    RUN_TEST(test_correction_excludes_pending_slew);
+    return UNITY_END();
+}
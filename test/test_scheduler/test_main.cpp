@@ -0,0 +1,51 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "scheduler.h"
+
+static IdleScheduler scheduler;
+
+void setUp() {
+    scheduler = IdleScheduler();
+    scheduler.begin();
+}
+
+void tearDown() {
+}
+
+void test_sleeps_until_earliest_deadline() {
+    TEST_ASSERT_EQUAL(IDLE_SLEEP_MODE, WiFi.sleepMode);
+    scheduler.sleep();      // deadline of begin() has passed, only yields
+    const uint32_t start = millis();
+    scheduler.until(start + 30);
+    scheduler.until(start + 20);
+    scheduler.until(start + 40);
+    scheduler.sleep();
+    TEST_ASSERT_EQUAL(20, millis() - start);
+}
+
+void test_sleep_is_capped() {
+    scheduler.sleep();
+    const uint32_t start = millis();
+    scheduler.until(start + 10 * IDLE_MAX_SLEEP_MS);
+    scheduler.sleep();
+    TEST_ASSERT_EQUAL(IDLE_MAX_SLEEP_MS, millis() - start);
+}
+
+void test_duty_cycle_and_wakeups_per_second() {
+    // 10 ms of work every 40 ms for a few seconds
+    for (uint16_t i = 0; i < 100; i++) {
+        host::advance(10000);
+        scheduler.until(millis() + 30);
+        scheduler.sleep();
+    }
+    TEST_ASSERT_INT_WITHIN(10, 250, scheduler.getDutyCycle());
+    TEST_ASSERT_INT_WITHIN(1, 25, scheduler.getWakeups());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sleeps_until_earliest_deadline);
+    RUN_TEST(test_sleep_is_capped);
+    RUN_TEST(test_duty_cycle_and_wakeups_per_second);
+    return UNITY_END();
+}
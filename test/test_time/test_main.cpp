@@ -0,0 +1,109 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "mytime.h"
+
+#define JANUARY_2024 1704067200L    // 2024-01-01T00:00:00Z
+#define MARCH_2024 1709251200L  // 2024-03-01T00:00:00Z
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// applies rules to TimeZone and to host libc, which serves as reference
+static void setZone(const char* rules) {
+    NtpHelper::initializeTimezone(rules);
+    LocalTime::invalidate();
+}
+
+static void assertEqualTime(const tm& expected, const tm& actual, const char* message) {
+    TEST_ASSERT_EQUAL_MESSAGE(expected.tm_hour, actual.tm_hour, message);
+    TEST_ASSERT_EQUAL_MESSAGE(expected.tm_min, actual.tm_min, message);
+    TEST_ASSERT_EQUAL_MESSAGE(expected.tm_sec, actual.tm_sec, message);
+    TEST_ASSERT_EQUAL_MESSAGE(expected.tm_isdst, actual.tm_isdst, message);
+}
+
+// walk cached decomposition second by second and compare with full TimeZone
+// conversion and with localtime_r()
+static void sweep(const char* rules, time_t start, time_t length) {
+    setZone(rules);
+    char message[48];
+    for (time_t t = start; t < start + length; t++) {
+        tm expected, reference;
+        TimeZone::current().toLocal(t, expected);
+        localtime_r(&t, &reference);
+        const tm& actual = LocalTime::at(t);
+        snprintf(message, sizeof(message), "%s at %ld", rules, (long)t);
+        assertEqualTime(reference, expected, message);
+        assertEqualTime(expected, actual, message);
+    }
+}
+
+void test_cache_follows_transition_at_full_hour() {
+    // 2024-03-31T01:00:00Z
+    sweep("CET-1CEST,M3.5.0,M10.5.0/3", 1711843200L - 7200, 14400);
+}
+
+void test_cache_follows_transition_inside_hour() {
+    // DST starts 2024-03-31 at 02:30 local, 01:30 UTC
+    sweep("AAA-1BBB,M3.5.0/2:30,M10.5.0/3", 1711848600L - 7200, 14400);
+}
+
+void test_cache_follows_half_hour_dst_shift() {
+    // Lord Howe, DST of 30 minutes ends 2024-04-07 at 02:00 local
+    sweep("<+1030>-10:30<+11>-11,M10.1.0,M4.1.0", 1712415600L - 7200, 14400);
+}
+
+// every precomputed transition of zones with negative offsets, southern hemisphere
+// DST, Julian day dates and transition times past midnight
+void test_transitions_match_libc() {
+    static const char* zones[] = {
+        "EST5EDT,M3.2.0,M11.1.0",
+        "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",
+        "AEST-10AEDT,M10.1.0,M4.1.0/3",
+        "NZST-12NZDT,M9.5.0,M4.1.0/3",
+        "IST-2IDT,M3.4.4/26,M10.5.0",
+        "XXX3YYY,J60/1,300/25",
+    };
+    for (const char* rules : zones) {
+        setZone(rules);
+        time_t t = JANUARY_2024;
+        for (uint8_t i = 0; i < 8; i++) {
+            t = TimeZone::current().nextTransition(t);
+            sweep(rules, t - 3600, 7200);
+        }
+    }
+}
+
+void test_cache_is_kept_over_clock_adjustment() {
+    setZone("CET-1CEST,M3.5.0,M10.5.0/3");
+    const tm& before = LocalTime::at(MARCH_2024 + 59);
+    TEST_ASSERT_EQUAL(59, before.tm_sec);
+    const timeval tv = { MARCH_2024, 500000 };
+    settimeofday(&tv, NULL);
+    const tm& after = LocalTime::at(MARCH_2024 + 60);
+    TEST_ASSERT_EQUAL(1, after.tm_hour);
+    TEST_ASSERT_EQUAL(1, after.tm_min);
+    TEST_ASSERT_EQUAL(0, after.tm_sec);
+}
+
+void test_next_transition() {
+    TimeZone& zone = TimeZone::current();
+    TEST_ASSERT_TRUE(zone.set("CET-1CEST,M3.5.0,M10.5.0/3"));
+    TEST_ASSERT_EQUAL(1711846800L, zone.nextTransition(MARCH_2024));
+    TEST_ASSERT_EQUAL(1729990800L, zone.nextTransition(1711846800L));
+    TEST_ASSERT_TRUE(zone.set("UTC0"));
+    TEST_ASSERT_GREATER_THAN(MARCH_2024, zone.nextTransition(MARCH_2024));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_cache_follows_transition_at_full_hour);
+    RUN_TEST(test_cache_follows_transition_inside_hour);
+    RUN_TEST(test_cache_follows_half_hour_dst_shift);
+    RUN_TEST(test_transitions_match_libc);
+    RUN_TEST(test_cache_is_kept_over_clock_adjustment);
+    RUN_TEST(test_next_transition);
+    return UNITY_END();
+}
@@ -0,0 +1,60 @@
+#include <unity.h>
+#include "ws2812.h"
+
+// WS2812 bit 0 and 1 as four output bits
+#define BIT0 0x8
+#define BIT1 0xE
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// output bits of sample in transmission order, lower half word goes first
+static uint32_t sent(uint32_t sample) {
+    return sample << 16 | sample >> 16;
+}
+
+void test_bits_are_1000_and_1110_patterns() {
+    TEST_ASSERT_EQUAL_HEX32(0x88888888, sent(Ws2812Encoder::sample(0x00)));
+    TEST_ASSERT_EQUAL_HEX32(0xEEEEEEEE, sent(Ws2812Encoder::sample(0xFF)));
+    // most significant bit first
+    TEST_ASSERT_EQUAL_HEX32(0xE8888888, sent(Ws2812Encoder::sample(0x80)));
+    TEST_ASSERT_EQUAL_HEX32(0x8888888E, sent(Ws2812Encoder::sample(0x01)));
+    TEST_ASSERT_EQUAL_HEX32(0x8E8E8E8E, sent(Ws2812Encoder::sample(0x55)));
+    TEST_ASSERT_EQUAL_HEX32(0xE88E8EEE, sent(Ws2812Encoder::sample(0x97)));
+}
+
+void test_every_byte_decodes_back() {
+    for (uint16_t value = 0; value < 256; value++) {
+        const uint32_t bits = sent(Ws2812Encoder::sample(value));
+        uint8_t decoded = 0;
+        for (int8_t i = 7; i >= 0; i--) {
+            const uint8_t nibble = (bits >> (i * 4)) & 0x0F;
+            TEST_ASSERT_TRUE(nibble == BIT0 || nibble == BIT1);
+            decoded = decoded << 1 | (nibble == BIT1);
+        }
+        TEST_ASSERT_EQUAL_HEX8(value, decoded);
+    }
+}
+
+void test_pixels_encoded_in_grb_order() {
+    const uint32_t pixels[2] = { 0xFF0080, 0x000100 };
+    uint32_t samples[2 * WS2812_SAMPLES_PER_PIXEL];
+    Ws2812Encoder::encode(pixels, 2, samples);
+    TEST_ASSERT_EQUAL_HEX32(Ws2812Encoder::sample(0x00), samples[0]); // green
+    TEST_ASSERT_EQUAL_HEX32(Ws2812Encoder::sample(0xFF), samples[1]); // red
+    TEST_ASSERT_EQUAL_HEX32(Ws2812Encoder::sample(0x80), samples[2]); // blue
+    TEST_ASSERT_EQUAL_HEX32(Ws2812Encoder::sample(0x01), samples[3]);
+    TEST_ASSERT_EQUAL_HEX32(Ws2812Encoder::sample(0x00), samples[4]);
+    TEST_ASSERT_EQUAL_HEX32(Ws2812Encoder::sample(0x00), samples[5]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_bits_are_1000_and_1110_patterns);
+    RUN_TEST(test_every_byte_decodes_back);
+    RUN_TEST(test_pixels_encoded_in_grb_order);
+    return UNITY_END();
+}